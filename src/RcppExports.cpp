@@ -6,33 +6,304 @@
 using namespace Rcpp;
 
 // xl_check_grammar_
-void xl_check_grammar_();
-RcppExport SEXP _xltoken_xl_check_grammar_() {
+Rcpp::List xl_check_grammar_(Rcpp::CharacterVector corpus);
+RcppExport SEXP _xltoken_xl_check_grammar_(SEXP corpusSEXP) {
 BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    xl_check_grammar_();
-    return R_NilValue;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type corpus(corpusSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_check_grammar_(corpus));
+    return rcpp_result_gen;
 END_RCPP
 }
 // xl_formula_
-Rcpp::List xl_formula_(Rcpp::CharacterVector x);
-RcppExport SEXP _xltoken_xl_formula_(SEXP xSEXP) {
+Rcpp::List xl_formula_(Rcpp::CharacterVector x, Rcpp::CharacterVector sheet, Rcpp::CharacterVector name, Rcpp::CharacterVector name_sheet, Rcpp::CharacterVector name_formula, Rcpp::CharacterVector cache);
+RcppExport SEXP _xltoken_xl_formula_(SEXP xSEXP, SEXP sheetSEXP, SEXP nameSEXP, SEXP name_sheetSEXP, SEXP name_formulaSEXP, SEXP cacheSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type sheet(sheetSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type name(nameSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type name_sheet(name_sheetSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type name_formula(name_formulaSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type cache(cacheSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_formula_(x, sheet, name, name_sheet, name_formula, cache));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_edit_
+Rcpp::List xl_edit_(Rcpp::CharacterVector x, Rcpp::List tokens, int at, int deleted, Rcpp::CharacterVector inserted, Rcpp::CharacterVector sheet, Rcpp::CharacterVector name, Rcpp::CharacterVector name_sheet, Rcpp::CharacterVector name_formula);
+RcppExport SEXP _xltoken_xl_edit_(SEXP xSEXP, SEXP tokensSEXP, SEXP atSEXP, SEXP deletedSEXP, SEXP insertedSEXP, SEXP sheetSEXP, SEXP nameSEXP, SEXP name_sheetSEXP, SEXP name_formulaSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type tokens(tokensSEXP);
+    Rcpp::traits::input_parameter< int >::type at(atSEXP);
+    Rcpp::traits::input_parameter< int >::type deleted(deletedSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type inserted(insertedSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type sheet(sheetSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type name(nameSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type name_sheet(name_sheetSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type name_formula(name_formulaSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_edit_(x, tokens, at, deleted, inserted, sheet, name, name_sheet, name_formula));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_tokens_write_
+void xl_tokens_write_(Rcpp::List tokens, std::string path);
+RcppExport SEXP _xltoken_xl_tokens_write_(SEXP tokensSEXP, SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type tokens(tokensSEXP);
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    xl_tokens_write_(tokens, path);
+    return R_NilValue;
+END_RCPP
+}
+// xl_tokens_read_
+Rcpp::List xl_tokens_read_(std::string path);
+RcppExport SEXP _xltoken_xl_tokens_read_(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_tokens_read_(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_formula_arrow_
+SEXP xl_formula_arrow_(Rcpp::CharacterVector x, Rcpp::CharacterVector path, int batch);
+RcppExport SEXP _xltoken_xl_formula_arrow_(SEXP xSEXP, SEXP pathSEXP, SEXP batchSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< int >::type batch(batchSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_formula_arrow_(x, path, batch));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_formula_stream_
+SEXP xl_formula_stream_(std::string path, double chunk);
+RcppExport SEXP _xltoken_xl_formula_stream_(SEXP pathSEXP, SEXP chunkSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< double >::type chunk(chunkSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_formula_stream_(path, chunk));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_formula_next_
+SEXP xl_formula_next_(SEXP stream);
+RcppExport SEXP _xltoken_xl_formula_next_(SEXP streamSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type stream(streamSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_formula_next_(stream));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_formula_pipeline_
+Rcpp::List xl_formula_pipeline_(std::string input, std::string output, int threads, int batch);
+RcppExport SEXP _xltoken_xl_formula_pipeline_(SEXP inputSEXP, SEXP outputSEXP, SEXP threadsSEXP, SEXP batchSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type input(inputSEXP);
+    Rcpp::traits::input_parameter< std::string >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< int >::type batch(batchSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_formula_pipeline_(input, output, threads, batch));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_formula_cache_
+Rcpp::List xl_formula_cache_(double size, bool clear);
+RcppExport SEXP _xltoken_xl_formula_cache_(SEXP sizeSEXP, SEXP clearSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< double >::type size(sizeSEXP);
+    Rcpp::traits::input_parameter< bool >::type clear(clearSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_formula_cache_(size, clear));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_formula_budget_
+Rcpp::List xl_formula_budget_(double steps);
+RcppExport SEXP _xltoken_xl_formula_budget_(SEXP stepsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< double >::type steps(stepsSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_formula_budget_(steps));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_formula_fast_path_
+Rcpp::List xl_formula_fast_path_(bool reset);
+RcppExport SEXP _xltoken_xl_formula_fast_path_(SEXP resetSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< bool >::type reset(resetSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_formula_fast_path_(reset));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_formula_corpus_
+Rcpp::CharacterVector xl_formula_corpus_(int n, double seed, int depth, double functions, double references, int string_length, double sheets);
+RcppExport SEXP _xltoken_xl_formula_corpus_(SEXP nSEXP, SEXP seedSEXP, SEXP depthSEXP, SEXP functionsSEXP, SEXP referencesSEXP, SEXP string_lengthSEXP, SEXP sheetsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type n(nSEXP);
+    Rcpp::traits::input_parameter< double >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< int >::type depth(depthSEXP);
+    Rcpp::traits::input_parameter< double >::type functions(functionsSEXP);
+    Rcpp::traits::input_parameter< double >::type references(referencesSEXP);
+    Rcpp::traits::input_parameter< int >::type string_length(string_lengthSEXP);
+    Rcpp::traits::input_parameter< double >::type sheets(sheetsSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_formula_corpus_(n, seed, depth, functions, references, string_length, sheets));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_names_
+Rcpp::List xl_names_(Rcpp::CharacterVector name, Rcpp::CharacterVector name_sheet, Rcpp::CharacterVector name_formula);
+RcppExport SEXP _xltoken_xl_names_(SEXP nameSEXP, SEXP name_sheetSEXP, SEXP name_formulaSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type name(nameSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type name_sheet(name_sheetSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type name_formula(name_formulaSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_names_(name, name_sheet, name_formula));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_graph_
+Rcpp::List xl_graph_(Rcpp::CharacterVector sheet, Rcpp::IntegerVector row, Rcpp::IntegerVector col, Rcpp::CharacterVector formula, Rcpp::CharacterVector name, Rcpp::CharacterVector name_sheet, Rcpp::CharacterVector name_formula);
+RcppExport SEXP _xltoken_xl_graph_(SEXP sheetSEXP, SEXP rowSEXP, SEXP colSEXP, SEXP formulaSEXP, SEXP nameSEXP, SEXP name_sheetSEXP, SEXP name_formulaSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type sheet(sheetSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type row(rowSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type col(colSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type formula(formulaSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type name(nameSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type name_sheet(name_sheetSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type name_formula(name_formulaSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_graph_(sheet, row, col, formula, name, name_sheet, name_formula));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_levels_
+Rcpp::List xl_levels_(Rcpp::IntegerVector offsets, Rcpp::IntegerVector precedents, int threads);
+RcppExport SEXP _xltoken_xl_levels_(SEXP offsetsSEXP, SEXP precedentsSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type offsets(offsetsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type precedents(precedentsSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_levels_(offsets, precedents, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_shift_
+Rcpp::CharacterVector xl_shift_(Rcpp::CharacterVector x, Rcpp::CharacterVector sheet, Rcpp::CharacterVector edit_sheet, bool rows, int index, int count, int threads);
+RcppExport SEXP _xltoken_xl_shift_(SEXP xSEXP, SEXP sheetSEXP, SEXP edit_sheetSEXP, SEXP rowsSEXP, SEXP indexSEXP, SEXP countSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type sheet(sheetSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type edit_sheet(edit_sheetSEXP);
+    Rcpp::traits::input_parameter< bool >::type rows(rowsSEXP);
+    Rcpp::traits::input_parameter< int >::type index(indexSEXP);
+    Rcpp::traits::input_parameter< int >::type count(countSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_shift_(x, sheet, edit_sheet, rows, index, count, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_rename_
+Rcpp::CharacterVector xl_rename_(Rcpp::CharacterVector x, Rcpp::CharacterVector from, Rcpp::CharacterVector to, int threads);
+RcppExport SEXP _xltoken_xl_rename_(SEXP xSEXP, SEXP fromSEXP, SEXP toSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type from(fromSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type to(toSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_rename_(x, from, to, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_shared_
+Rcpp::List xl_shared_(Rcpp::IntegerVector row, Rcpp::IntegerVector col, Rcpp::CharacterVector x, int threads);
+RcppExport SEXP _xltoken_xl_shared_(SEXP rowSEXP, SEXP colSEXP, SEXP xSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type row(rowSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type col(colSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_shared_(row, col, x, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xl_inconsistent_
+Rcpp::List xl_inconsistent_(Rcpp::IntegerVector row, Rcpp::IntegerVector col, Rcpp::CharacterVector x, int threads);
+RcppExport SEXP _xltoken_xl_inconsistent_(SEXP rowSEXP, SEXP colSEXP, SEXP xSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type row(rowSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type col(colSEXP);
     Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type x(xSEXP);
-    rcpp_result_gen = Rcpp::wrap(xl_formula_(x));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(xl_inconsistent_(row, col, x, threads));
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_xltoken_xl_check_grammar_", (DL_FUNC) &_xltoken_xl_check_grammar_, 0},
-    {"_xltoken_xl_formula_", (DL_FUNC) &_xltoken_xl_formula_, 1},
+    {"_xltoken_xl_check_grammar_", (DL_FUNC) &_xltoken_xl_check_grammar_, 1},
+    {"_xltoken_xl_formula_", (DL_FUNC) &_xltoken_xl_formula_, 6},
+    {"_xltoken_xl_edit_", (DL_FUNC) &_xltoken_xl_edit_, 9},
+    {"_xltoken_xl_tokens_write_", (DL_FUNC) &_xltoken_xl_tokens_write_, 2},
+    {"_xltoken_xl_tokens_read_", (DL_FUNC) &_xltoken_xl_tokens_read_, 1},
+    {"_xltoken_xl_formula_arrow_", (DL_FUNC) &_xltoken_xl_formula_arrow_, 3},
+    {"_xltoken_xl_formula_stream_", (DL_FUNC) &_xltoken_xl_formula_stream_, 2},
+    {"_xltoken_xl_formula_next_", (DL_FUNC) &_xltoken_xl_formula_next_, 1},
+    {"_xltoken_xl_formula_pipeline_", (DL_FUNC) &_xltoken_xl_formula_pipeline_, 4},
+    {"_xltoken_xl_formula_cache_", (DL_FUNC) &_xltoken_xl_formula_cache_, 2},
+    {"_xltoken_xl_formula_budget_", (DL_FUNC) &_xltoken_xl_formula_budget_, 1},
+    {"_xltoken_xl_formula_fast_path_", (DL_FUNC) &_xltoken_xl_formula_fast_path_, 1},
+    {"_xltoken_xl_formula_corpus_", (DL_FUNC) &_xltoken_xl_formula_corpus_, 7},
+    {"_xltoken_xl_names_", (DL_FUNC) &_xltoken_xl_names_, 3},
+    {"_xltoken_xl_graph_", (DL_FUNC) &_xltoken_xl_graph_, 7},
+    {"_xltoken_xl_levels_", (DL_FUNC) &_xltoken_xl_levels_, 3},
+    {"_xltoken_xl_shift_", (DL_FUNC) &_xltoken_xl_shift_, 7},
+    {"_xltoken_xl_rename_", (DL_FUNC) &_xltoken_xl_rename_, 4},
+    {"_xltoken_xl_shared_", (DL_FUNC) &_xltoken_xl_shared_, 4},
+    {"_xltoken_xl_inconsistent_", (DL_FUNC) &_xltoken_xl_inconsistent_, 4},
     {NULL, NULL, 0}
 };
 
+void xl_init_(DllInfo* dll);
 RcppExport void R_init_xltoken(DllInfo *dll) {
     R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
     R_useDynamicSymbols(dll, FALSE);
+    xl_init_(dll);
 }
@@ -0,0 +1,94 @@
+#ifndef XLTOKEN_ARENA_HPP
+#define XLTOKEN_ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace xltoken
+{
+
+  // A view of characters owned by something else: either the formula being
+  // parsed, or an arena.  A null data pointer means there is no value (NA in
+  // R), which is different from an empty value.
+  struct span
+  {
+    const char * data;
+    std::size_t size;
+
+    span() : data( nullptr ), size( 0 ) {}
+    span( const char * d, const std::size_t n ) : data( d ), size( n ) {}
+
+    bool is_na() const { return data == nullptr; }
+    std::string string() const { return std::string( data, size ); }
+  };
+
+  // Bump allocator for the few values that can't be spans of the input, e.g.
+  // string literals with escaped quotes.  Everything is freed at once when the
+  // batch that owns it goes out of scope.
+  class arena
+  {
+    public:
+      explicit arena( const std::size_t block_size = 4096 )
+        : block_size_( block_size ), used_( 0 ), available_( 0 )
+      {}
+
+      char * allocate( const std::size_t n )
+      {
+        if ( blocks_.empty() || n > available_ ) {
+          const std::size_t size = std::max( n, block_size_ );
+          blocks_.push_back( std::unique_ptr< char[] >( new char[ size ] ) );
+          used_ = 0;
+          available_ = size;
+        }
+        char * out = blocks_.back().get() + used_;
+        used_ += n;
+        available_ -= n;
+        return out;
+      }
+
+      // Copy characters into the arena
+      span store( const char * data, const std::size_t n )
+      {
+        char * out = allocate( n );
+        std::memcpy( out, data, n );
+        return span( out, n );
+      }
+
+    private:
+      std::vector< std::unique_ptr< char[] > > blocks_;
+      std::size_t block_size_;
+      std::size_t used_;
+      std::size_t available_;
+  };
+
+  // Strip the doubled-quote escapes from the characters between the quotes of
+  // a string literal or a quoted sheet name.  When there aren't any, which is
+  // nearly always, the value is a span of the input and nothing is copied.
+  inline span unescape( const char * begin,
+                        const char * end,
+                        const char quote,
+                        arena & strings )
+  {
+    const char * first = std::find( begin, end, quote );
+    if ( first == end ) {
+      return span( begin, end - begin );
+    }
+    char * out = strings.allocate( end - begin );
+    std::size_t n = first - begin;
+    std::memcpy( out, begin, n );
+    for ( const char * p = first; p != end; ++p ) {
+      out[ n++ ] = *p;
+      if ( *p == quote ) {
+        ++p; // skip the second of the pair
+      }
+    }
+    return span( out, n );
+  }
+
+} // xltoken
+
+#endif
@@ -0,0 +1,504 @@
+#ifndef XLTOKEN_ARROW_IPC_HPP
+#define XLTOKEN_ARROW_IPC_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "token_table.hpp"
+
+namespace xltoken
+{
+
+  // Token tables as an Arrow IPC stream, written by hand so that nothing
+  // needs linking to Arrow.  See
+  // https://arrow.apache.org/docs/format/Columnar.html#serialization-and-interprocess-communication-ipc
+  //
+  // The stream's schema is
+  //
+  //   formula_id  int32
+  //   type        dictionary<int16, utf8>
+  //   start       int32, from 1 as in xl_formula()
+  //   length      int32
+  //   token       dictionary<int32, utf8>
+  //
+  // and each table becomes a record batch, preceded by dictionary batches of
+  // any types and tokens that are new since the last one, so that a table
+  // can be written and cleared at a time.  Once the tokens' dictionary has
+  // more than a cap of strings, it's started again, and sent whole rather
+  // than as a delta, so that it stays about as big as a batch or two.
+
+  namespace arrow_detail
+  {
+
+    // Just enough of a FlatBuffers builder for Arrow's messages.  Offsets
+    // to other objects are unsigned, so each object is written after
+    // whatever refers to it, and the reference is patched to point forward
+    // to it.  Each vtable is just before its table.  FlatBuffers are
+    // little-endian, so this assumes the machine is too.
+    class flatbuffer
+    {
+      public:
+        // A field of a table: a scalar of 1, 2, 4 or 8 bytes, a reference
+        // to an object, or absent
+        struct field
+        {
+          std::size_t size;
+          std::uint64_t bits;
+          bool reference;
+        };
+
+        static field none() { return field{ 0, 0, false }; }
+        static field scalar( const std::size_t size, const std::uint64_t bits ) { return field{ size, bits, false }; }
+        static field reference() { return field{ 4, 0, true }; }
+
+        flatbuffer() : bytes_( 4, 0 ) {} // the offset of the root table
+
+        // Write a table with its fields in order of id, returning where it
+        // is, and where its references are in 'references'
+        std::size_t table( const std::vector< field > & fields,
+                           std::vector< std::size_t > & references )
+        {
+          // Lay the fields out after the offset of the vtable, biggest first
+          // so that each is aligned
+          std::vector< std::size_t > order;
+          for ( std::size_t i = 0; i < fields.size(); ++i ) {
+            if ( fields[ i ].size != 0 ) {
+              order.push_back( i );
+            }
+          }
+          std::stable_sort( order.begin(), order.end(), [ & ]( const std::size_t a, const std::size_t b ) {
+            return fields[ a ].size > fields[ b ].size;
+          } );
+          std::vector< std::uint16_t > at( fields.size(), 0 );
+          std::size_t size = 4;
+          for ( std::size_t k = 0; k < order.size(); ++k ) {
+            const std::size_t n = fields[ order[ k ] ].size;
+            size = ( size + n - 1 ) / n * n;
+            at[ order[ k ] ] = size;
+            size += n;
+          }
+
+          align( 2 );
+          const std::size_t vtable = bytes_.size();
+          scalar< std::uint16_t >( 4 + 2 * fields.size() );
+          scalar< std::uint16_t >( size );
+          for ( std::size_t i = 0; i < fields.size(); ++i ) {
+            scalar< std::uint16_t >( at[ i ] );
+          }
+          align( 8 );
+          const std::size_t table = bytes_.size();
+          bytes_.resize( table + size, 0 );
+          put< std::int32_t >( table, table - vtable );
+          references.clear();
+          for ( std::size_t i = 0; i < fields.size(); ++i ) {
+            const field & f = fields[ i ];
+            if ( f.reference ) {
+              references.push_back( table + at[ i ] );
+            } else if ( f.size != 0 ) {
+              std::memcpy( &bytes_[ table + at[ i ] ], &f.bits, f.size ); // little end first
+            }
+          }
+          return table;
+        }
+
+        std::size_t string( const std::string & s )
+        {
+          align( 4 );
+          const std::size_t at = bytes_.size();
+          scalar< std::uint32_t >( s.size() );
+          bytes_.insert( bytes_.end(), s.begin(), s.end() );
+          bytes_.push_back( 0 );
+          return at;
+        }
+
+        // A vector of structs of 'size' bytes, which are aligned to 8
+        std::size_t structs( const void * data, const std::size_t count, const std::size_t size )
+        {
+          while ( bytes_.size() % 8 != 4 ) {
+            bytes_.push_back( 0 );
+          }
+          const std::size_t at = bytes_.size();
+          scalar< std::uint32_t >( count );
+          const char * begin = static_cast< const char * >( data );
+          bytes_.insert( bytes_.end(), begin, begin + count * size );
+          return at;
+        }
+
+        // A vector of references, returned in 'references'
+        std::size_t references( const std::size_t count, std::vector< std::size_t > & references )
+        {
+          align( 4 );
+          const std::size_t at = bytes_.size();
+          scalar< std::uint32_t >( count );
+          references.clear();
+          for ( std::size_t i = 0; i < count; ++i ) {
+            references.push_back( bytes_.size() );
+            scalar< std::uint32_t >( 0 );
+          }
+          return at;
+        }
+
+        // Point a reference to an object
+        void patch( const std::size_t reference, const std::size_t object )
+        {
+          put< std::uint32_t >( reference, object - reference );
+        }
+
+        // The finished buffer, given the root table, padded to a multiple of
+        // 8 bytes
+        const std::string & finish( const std::size_t root )
+        {
+          patch( 0, root );
+          align( 8 );
+          return bytes_;
+        }
+
+      private:
+        std::string bytes_;
+
+        void align( const std::size_t n )
+        {
+          bytes_.resize( ( bytes_.size() + n - 1 ) / n * n, 0 );
+        }
+
+        template< typename T >
+          void scalar( const T value )
+          {
+            bytes_.append( reinterpret_cast< const char * >( &value ), sizeof( T ) );
+          }
+
+        template< typename T >
+          void put( const std::size_t at, const T value )
+          {
+            std::memcpy( &bytes_[ at ], &value, sizeof( T ) );
+          }
+    };
+
+    // Arrow's enums
+    const std::uint64_t metadata_v5 = 4;
+    const std::uint64_t header_schema = 1;
+    const std::uint64_t header_dictionary_batch = 2;
+    const std::uint64_t header_record_batch = 3;
+    const std::uint64_t type_int = 2;
+    const std::uint64_t type_utf8 = 5;
+
+    // Strings in the tokens' dictionary before it's started again
+    const std::size_t max_dictionary_tokens = 1 << 20;
+
+    // A FieldNode or a Buffer of a RecordBatch
+    struct pair
+    {
+      std::int64_t first;
+      std::int64_t second;
+    };
+
+    inline bool little_endian()
+    {
+      const std::uint16_t one = 1;
+      return *reinterpret_cast< const char * >( &one ) == 1;
+    }
+
+    // The body of a record batch: its buffers, each padded to 8 bytes
+    class body
+    {
+      public:
+        void column( const std::size_t length )
+        {
+          nodes.push_back( pair{ static_cast< std::int64_t >( length ), 0 } );
+          buffer( nullptr, 0 ); // no validity bitmap, so no nulls
+        }
+
+        void buffer( const void * data, const std::size_t size )
+        {
+          buffers.push_back( pair{ static_cast< std::int64_t >( bytes.size() ),
+                                   static_cast< std::int64_t >( size ) } );
+          bytes.append( static_cast< const char * >( data ), size );
+          bytes.resize( ( bytes.size() + 7 ) / 8 * 8, 0 );
+        }
+
+        std::string bytes;
+        std::vector< pair > nodes;
+        std::vector< pair > buffers;
+    };
+
+    // The flatbuffer of a RecordBatch table, as the last thing written, so
+    // that 'table' can be followed by others in the same buffer
+    inline void record_batch( flatbuffer & fb, const std::size_t reference,
+                              const std::size_t length, const body & b )
+    {
+      typedef flatbuffer fb_t;
+      std::vector< std::size_t > refs;
+      const std::size_t table = fb.table( { fb_t::scalar( 8, length ), fb_t::reference(),
+                                            fb_t::reference() }, refs );
+      fb.patch( reference, table );
+      fb.patch( refs[ 0 ], fb.structs( b.nodes.data(), b.nodes.size(), sizeof( pair ) ) );
+      fb.patch( refs[ 1 ], fb.structs( b.buffers.data(), b.buffers.size(), sizeof( pair ) ) );
+    }
+
+    // A Message table whose header is written by 'header', given the
+    // reference to patch
+    template< typename Header >
+      std::string message( const std::uint64_t type, const std::size_t body_length,
+                           Header header )
+      {
+        typedef flatbuffer fb_t;
+        flatbuffer fb;
+        std::vector< std::size_t > refs;
+        const std::size_t root = fb.table( { fb_t::scalar( 2, metadata_v5 ), fb_t::scalar( 1, type ),
+                                             fb_t::reference(), fb_t::scalar( 8, body_length ) },
+                                           refs );
+        header( fb, refs[ 0 ] );
+        return fb.finish( root );
+      }
+
+  } // arrow_detail
+
+  // Sinks for the stream
+  class file_sink
+  {
+    public:
+      explicit file_sink( const std::string & path )
+        : path_( path ), file_( std::fopen( path.c_str(), "wb" ) )
+      {
+        if ( file_ == nullptr ) {
+          throw std::runtime_error( "Can't write to " + path );
+        }
+      }
+
+      ~file_sink()
+      {
+        if ( file_ != nullptr ) {
+          std::fclose( file_ );
+        }
+      }
+
+      void write( const char * data, const std::size_t n )
+      {
+        if ( n != 0 && std::fwrite( data, 1, n, file_ ) != n ) {
+          throw std::runtime_error( "Can't write to " + path_ );
+        }
+      }
+
+      void close()
+      {
+        const bool closed = std::fclose( file_ ) == 0;
+        file_ = nullptr;
+        if ( !closed ) {
+          throw std::runtime_error( "Can't write to " + path_ );
+        }
+      }
+
+    private:
+      std::string path_;
+      std::FILE * file_;
+
+      file_sink( const file_sink & );
+      file_sink & operator=( const file_sink & );
+  };
+
+  class buffer_sink
+  {
+    public:
+      void write( const char * data, const std::size_t n ) { bytes.append( data, n ); }
+      void close() {}
+
+      std::string bytes;
+  };
+
+  // Writes token tables to a sink, which has write( const char *, size_t )
+  // and close().  The strings of tokens aren't copied, so the formulas must
+  // outlive the writer.
+  template< typename Sink >
+    class arrow_token_writer
+    {
+      public:
+        explicit arrow_token_writer( Sink & sink,
+                                     const std::size_t max_tokens = arrow_detail::max_dictionary_tokens )
+          : sink_( sink ), types_written_( 0 ), tokens_written_( 0 ), max_tokens_( max_tokens )
+        {
+          write_schema();
+        }
+
+        void write( const token_table & t )
+        {
+          if ( tokens_.strings().size() > max_tokens_ ) {
+            tokens_ = string_dictionary();
+            tokens_written_ = 0;
+          }
+          const std::size_t n = t.size();
+          std::vector< std::int32_t > starts( n ), lengths( n );
+          std::vector< std::int16_t > type_codes( n );
+          std::vector< std::int32_t > token_codes( n );
+          for ( std::size_t i = 0; i < n; ++i ) {
+            type_codes[ i ] = i > 0 && t.types[ i ] == t.types[ i - 1 ]
+                              ? type_codes[ i - 1 ]
+                              : type_code( t.types[ i ] );
+            starts[ i ] = t.starts[ i ] + 1;
+            lengths[ i ] = t.tokens[ i ].size;
+            token_codes[ i ] = tokens_.intern( t.tokens[ i ] ) - 1;
+          }
+
+          std::vector< span > types( types_.size() );
+          for ( std::size_t k = 0; k < types_.size(); ++k ) {
+            types[ k ] = span( types_[ k ].data(), types_[ k ].size() );
+          }
+          write_dictionary( 0, types, types_written_ );
+          write_dictionary( 1, tokens_.strings(), tokens_written_ );
+
+          arrow_detail::body b;
+          b.column( n );
+          b.buffer( t.formula_ids.data(), n * sizeof( std::int32_t ) );
+          b.column( n );
+          b.buffer( type_codes.data(), n * sizeof( std::int16_t ) );
+          b.column( n );
+          b.buffer( starts.data(), n * sizeof( std::int32_t ) );
+          b.column( n );
+          b.buffer( lengths.data(), n * sizeof( std::int32_t ) );
+          b.column( n );
+          b.buffer( token_codes.data(), n * sizeof( std::int32_t ) );
+          write_message( arrow_detail::message(
+            arrow_detail::header_record_batch, b.bytes.size(),
+            [ & ]( arrow_detail::flatbuffer & fb, const std::size_t reference ) {
+              arrow_detail::record_batch( fb, reference, n, b );
+            } ), b.bytes );
+        }
+
+        // Write the end of the stream
+        void close()
+        {
+          const std::uint32_t end[ 2 ] = { 0xFFFFFFFF, 0 };
+          sink_.write( reinterpret_cast< const char * >( end ), sizeof( end ) );
+          sink_.close();
+        }
+
+      private:
+        Sink & sink_;
+        std::vector< std::string > types_;
+        std::size_t types_written_;
+        string_dictionary tokens_;
+        std::size_t tokens_written_;
+        std::size_t max_tokens_;
+
+        std::int16_t type_code( const std::string & type )
+        {
+          const std::size_t code = std::find( types_.begin(), types_.end(), type ) - types_.begin();
+          if ( code == types_.size() ) {
+            types_.push_back( type );
+          }
+          return code;
+        }
+
+        // Each message is prefixed with a continuation marker and its
+        // length, and its body follows it
+        void write_message( const std::string & metadata, const std::string & body )
+        {
+          const std::uint32_t prefix[ 2 ] = { 0xFFFFFFFF,
+                                              static_cast< std::uint32_t >( metadata.size() ) };
+          sink_.write( reinterpret_cast< const char * >( prefix ), sizeof( prefix ) );
+          sink_.write( metadata.data(), metadata.size() );
+          sink_.write( body.data(), body.size() );
+        }
+
+        void write_schema()
+        {
+          using arrow_detail::flatbuffer;
+          write_message( arrow_detail::message(
+            arrow_detail::header_schema, 0,
+            []( flatbuffer & fb, const std::size_t reference ) {
+              std::vector< std::size_t > refs, fields;
+              const std::size_t schema = fb.table( {
+                  flatbuffer::scalar( 2, arrow_detail::little_endian() ? 0 : 1 ),
+                  flatbuffer::reference() }, refs );
+              fb.patch( reference, schema );
+              fb.patch( refs[ 0 ], fb.references( 5, fields ) );
+              field( fb, fields[ 0 ], "formula_id", -1 );
+              field( fb, fields[ 1 ], "type", 0 );
+              field( fb, fields[ 2 ], "start", -1 );
+              field( fb, fields[ 3 ], "length", -1 );
+              field( fb, fields[ 4 ], "token", 1 );
+            } ), std::string() );
+        }
+
+        // A field of the schema: int32, or a dictionary of strings with
+        // the given id
+        static void field( arrow_detail::flatbuffer & fb, const std::size_t reference,
+                           const std::string & name, const int dictionary )
+        {
+          using arrow_detail::flatbuffer;
+          std::vector< std::size_t > refs, children, index;
+          const bool coded = dictionary >= 0;
+          const std::size_t table = fb.table( {
+              flatbuffer::reference(),     // name
+              flatbuffer::scalar( 1, 0 ),  // nullable
+              flatbuffer::scalar( 1, coded ? arrow_detail::type_utf8 : arrow_detail::type_int ),
+              flatbuffer::reference(),     // type
+              coded ? flatbuffer::reference() : flatbuffer::none(),
+              flatbuffer::reference() },   // children
+            refs );
+          fb.patch( reference, table );
+          fb.patch( refs[ 0 ], fb.string( name ) );
+          if ( coded ) {
+            fb.patch( refs[ 1 ], fb.table( {}, index ) ); // Utf8 has no fields
+            // Types are few, but tokens can be many
+            fb.patch( refs[ 2 ], fb.table( { flatbuffer::scalar( 8, dictionary ),
+                                             flatbuffer::reference(),
+                                             flatbuffer::scalar( 1, 0 ) }, index ) );
+            fb.patch( index[ 0 ], int_type( fb, dictionary == 0 ? 16 : 32 ) );
+            fb.patch( refs[ 3 ], fb.references( 0, children ) );
+          } else {
+            fb.patch( refs[ 1 ], int_type( fb, 32 ) );
+            fb.patch( refs[ 2 ], fb.references( 0, children ) );
+          }
+        }
+
+        static std::size_t int_type( arrow_detail::flatbuffer & fb, const int bits )
+        {
+          std::vector< std::size_t > refs;
+          return fb.table( { arrow_detail::flatbuffer::scalar( 4, bits ),
+                             arrow_detail::flatbuffer::scalar( 1, 1 ) }, refs );
+        }
+
+        // The strings of a dictionary from 'written' on, as a delta, or the
+        // whole dictionary if none of it has been written
+        void write_dictionary( const std::int64_t id, const std::vector< span > & strings,
+                               std::size_t & written )
+        {
+          if ( written == strings.size() && written != 0 ) {
+            return;
+          }
+          const bool delta = written != 0;
+          const std::size_t n = strings.size() - written;
+          std::vector< std::int32_t > offsets( n + 1, 0 );
+          std::string data;
+          for ( std::size_t s = 0; s < n; ++s ) {
+            const span & string = strings[ written + s ];
+            data.append( string.data, string.size );
+            offsets[ s + 1 ] = data.size();
+          }
+          written = strings.size();
+
+          arrow_detail::body b;
+          b.column( n );
+          b.buffer( offsets.data(), offsets.size() * sizeof( std::int32_t ) );
+          b.buffer( data.data(), data.size() );
+          write_message( arrow_detail::message(
+            arrow_detail::header_dictionary_batch, b.bytes.size(),
+            [ & ]( arrow_detail::flatbuffer & fb, const std::size_t reference ) {
+              std::vector< std::size_t > refs;
+              const std::size_t table = fb.table( {
+                  arrow_detail::flatbuffer::scalar( 8, id ),
+                  arrow_detail::flatbuffer::reference(),
+                  arrow_detail::flatbuffer::scalar( 1, delta ) }, refs );
+              fb.patch( reference, table );
+              arrow_detail::record_batch( fb, refs[ 0 ], n, b );
+            } ), b.bytes );
+        }
+    };
+
+} // xltoken
+
+#endif
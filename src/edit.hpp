@@ -0,0 +1,322 @@
+#ifndef XLTOKEN_EDIT_HPP
+#define XLTOKEN_EDIT_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "xltoken.hpp"
+
+namespace xltoken
+{
+
+  // Re-tokenizing a formula after an edit, e.g. typing in one cell, without
+  // parsing the whole formula again.  Only the arguments of the innermost
+  // function call around the edit are parsed, and their tokens are spliced
+  // into the old ones.
+
+  // The arguments of a function call, up to and including the closing
+  // parenthesis, as matched by FunctionCall, ReferenceFunctionCall and
+  // UDFunctionCall respectively
+  struct EditedArguments
+    : seq< spaces, opt< Arguments >, spaces, CloseParen, eof >
+  {};
+
+  struct EditedUDFArguments
+    : seq< opt< Arguments >, spaces, CloseParen, eof >
+  {};
+
+  // A formula that the grammar matches to its end.  root matches a prefix of
+  // anything, e.g. just SUM of SUM(/2), leaving the tokens of what it tried
+  // on the way.
+  struct WholeFormula
+    : seq< root, eof >
+  {};
+
+  // Replace 'deleted' characters from 'offset' with 'inserted'
+  struct edit
+  {
+    std::size_t offset;
+    std::size_t deleted;
+    span inserted;
+  };
+
+  // Whether a position in a formula is within a string, a quoted sheet name
+  // or square brackets, and how deeply it is within parentheses.  Brackets
+  // use ' to escape characters instead of quoting.
+  struct nesting
+  {
+    char quote;    // " or ' while quoted, otherwise 0
+    bool escaped;
+    int brackets;
+    int parens;
+
+    nesting() : quote( 0 ), escaped( false ), brackets( 0 ), parens( 0 ) {}
+
+    void step( const char c )
+    {
+      if ( escaped ) {
+        escaped = false;
+      } else if ( quote != 0 ) {
+        quote = c == quote ? 0 : quote; // "" closes and reopens
+      } else if ( brackets != 0 ) {
+        escaped = c == '\'';
+        brackets += ( c == '[' ) - ( c == ']' );
+      } else if ( c == '"' || c == '\'' ) {
+        quote = c;
+      } else {
+        brackets += c == '[';
+        parens += ( c == '(' ) - ( c == ')' );
+      }
+    }
+
+    bool operator==( const nesting & other ) const
+    {
+      return quote == other.quote && escaped == other.escaped
+             && brackets == other.brackets && parens == other.parens;
+    }
+  };
+
+  namespace edit_detail
+  {
+
+    // Whether characters don't open or close anything that encloses them,
+    // e.g. "1,2" or "(1)" but not ")+(" or "\"", so that the parentheses
+    // around them are paired the same way with or without them
+    inline bool balanced( const char * data, const std::size_t n,
+                          const nesting & from )
+    {
+      nesting s = from;
+      for ( std::size_t i = 0; i < n; ++i ) {
+        s.step( data[ i ] );
+        if ( s.parens < from.parens || s.brackets < from.brackets ) {
+          return false;
+        }
+      }
+      return s == from;
+    }
+
+    // Whether the grammar matches all of a formula, without tokenizing it.
+    // The grammar tries the same rules whatever its actions, so this takes
+    // as many steps as tokenizing the formula did, which was within budget
+    // if its tokens include a function call.
+    inline bool whole( const span & text )
+    {
+      token_table scratch;
+      memory_input<> in( text.data, text.size, "original-formula" );
+      try {
+        return parse< WholeFormula >( in, scratch );
+      } catch ( const parse_error & ) {
+      }
+      return false;
+    }
+
+    // Move a span of one formula to the same characters of another, where
+    // the characters from 'moved' on are 'delta' further along.  Anything
+    // else, e.g. a value unescaped into an arena, is copied.
+    inline span move( const span & s, const span & from, const char * to,
+                      const std::size_t moved, const std::ptrdiff_t delta,
+                      arena & strings )
+    {
+      if ( s.is_na() ) {
+        return s;
+      }
+      if ( s.data >= from.data && s.data + s.size <= from.data + from.size ) {
+        const std::size_t at = s.data - from.data;
+        return span( to + at + ( at >= moved ? delta : 0 ), s.size );
+      }
+      return strings.store( s.data, s.size );
+    }
+
+    // Append row i of one table to another, given where its token is now
+    inline void copy_row( const token_table & from, const std::size_t i,
+                          token_table & to, const span & token, const int start,
+                          const span & value )
+    {
+      to.formula_ids.push_back( to.formula );
+      to.types.push_back( from.types[ i ] );
+      to.tokens.push_back( token );
+      to.starts.push_back( start );
+      to.values.push_back( value );
+      to.numbers.push_back( from.numbers[ i ] );
+      to.name_ids.push_back( 0 );
+      if ( from.name_ids[ i ] != 0 ) {
+        // Each token spells its own name, which is either its decoded value
+        // (a quoted sheet name) or the start of the token
+        const span & name = from.names.strings()[ from.name_ids[ i ] - 1 ];
+        to.name_ids.back() =
+          to.names.intern( !value.is_na() && equal_folded( value, name.data, name.size )
+                           ? value
+                           : span( token.data, name.size ) );
+      }
+    }
+
+  } // edit_detail
+
+  // Tokenize a formula after an edit, given its tokens before the edit.
+  // 'text' is the formula before the edit, and the table its tokens, as from
+  // parse_formula().  The edited formula is written to 'edited', which the
+  // tokens in 'out' are spans of.
+  //
+  // The arguments of the innermost function call that encloses the edit are
+  // parsed, then the next one out if that fails, and so on, until the whole
+  // formula is parsed.  Parentheses that aren't a function call, e.g. (1+2),
+  // don't count: the alternatives that the grammar tries for them emit
+  // tokens for everything inside them, so the function call must enclose
+  // them too.  A formula that the grammar didn't match to its end, e.g. one
+  // still being typed, is parsed whole, since its tokens are of wherever the
+  // grammar gave up, which an edit elsewhere can change.  Returns false if
+  // the edited formula couldn't be parsed.
+  inline bool parse_edit( const span & text,
+                          const token_table & before,
+                          const edit & change,
+                          std::string & edited,
+                          token_table & out )
+  {
+    edited.assign( text.data, change.offset );
+    edited.append( change.inserted.data, change.inserted.size );
+    edited.append( text.data + change.offset + change.deleted,
+                   text.size - change.offset - change.deleted );
+    out.formula_begin = edited.data();
+    const std::ptrdiff_t delta = static_cast< std::ptrdiff_t >( change.inserted.size )
+                                 - static_cast< std::ptrdiff_t >( change.deleted );
+
+    // The open parentheses around the edit, innermost last, if the edit
+    // doesn't change how they pair up
+    nesting state;
+    std::vector< std::size_t > opens;
+    for ( std::size_t i = 0; i < change.offset; ++i ) {
+      const int parens = state.parens;
+      state.step( text.data[ i ] );
+      if ( state.parens > parens ) {
+        opens.push_back( i );
+      } else if ( state.parens < parens && !opens.empty() ) {
+        opens.pop_back();
+      }
+    }
+    if ( !edit_detail::balanced( text.data, text.size, nesting() )
+         || !edit_detail::balanced( text.data + change.offset, change.deleted, state )
+         || !edit_detail::balanced( change.inserted.data, change.inserted.size, state ) ) {
+      opens.clear();
+    }
+
+    // Only those outside any that aren't a function call, i.e. don't follow
+    // a name
+    std::size_t region = opens.size();
+    for ( std::size_t k = 0; k < region; ++k ) {
+      const char c = opens[ k ] > 0 ? text.data[ opens[ k ] - 1 ] : ' ';
+      if ( !( std::isalnum( static_cast< unsigned char >( c ) ) || c == '_' || c == '.' ) ) {
+        region = k;
+      }
+    }
+
+    token_table fresh;
+    bool parsed = false;
+    bool checked = false;              // that the grammar matched all of text
+    std::size_t closed = opens.size(); // how many have been found to close
+    std::size_t scanned = change.offset + change.deleted;
+    std::size_t last = text.size;      // where the current one closes
+    int depth = state.parens;
+    while ( !parsed && region-- > 0 ) {
+      // Each closes when the depth first drops below where it was opened
+      while ( closed > region && scanned < text.size ) {
+        state.step( text.data[ scanned++ ] );
+        if ( state.parens < depth ) {
+          depth = state.parens;
+          last = scanned - 1;
+          --closed;
+        }
+      }
+      if ( closed > region ) {
+        break;
+      }
+
+      // The token that opens the call, for the rule that matched it
+      const std::size_t paren = opens[ region ];
+      int call = 0; // 1 built in, 2 UDF
+      for ( std::size_t i = 0; i < before.size(); ++i ) {
+        const std::size_t start = before.starts[ i ];
+        const span & token = before.tokens[ i ];
+        if ( start > paren || start + token.size <= paren ) {
+          continue;
+        }
+        const std::string & type = before.types[ i ];
+        if ( type == "UDF" ) {
+          if ( std::find( token.data, token.data + token.size, '(' ) - token.data
+               == static_cast< std::ptrdiff_t >( paren - start ) ) {
+            call = 2;
+          }
+        } else if ( start + token.size == paren + 1
+                    && ( type == "EXCEL-FUNCTION" || type == "REF-FUNCTION"
+                         || type == "REF-FUNCTION-COND" ) ) {
+          call = 1;
+        }
+      }
+      if ( call == 0 || ( !checked && !edit_detail::whole( text ) ) ) {
+        break;
+      }
+      checked = true;
+
+      // Within the same budget as parse_formula()
+      fresh = token_table();
+      fresh.formula = out.formula;
+      fresh.formula_begin = edited.data();
+      fresh.budget = formula_budget().steps.load( std::memory_order_relaxed );
+      memory_input<> in( edited.data() + paren + 1,
+                         edited.data() + last + delta + 1,
+                         "edited-formula" );
+      try {
+        parsed = call == 2
+                 ? parse< EditedUDFArguments, tokenize, budget_control >( in, fresh )
+                 : parse< EditedArguments, tokenize, budget_control >( in, fresh );
+      } catch ( const parse_error & ) {
+      } catch ( const budget_exceeded & ) {
+        // The whole formula would take longer still
+        out.push_status( "BUDGET_EXCEEDED", span( edited.data(), edited.size() ) );
+        ++formula_budget().exceeded;
+        return false;
+      }
+    }
+    if ( !parsed ) {
+      return parse_formula( edited.data(), edited.size(), out );
+    }
+
+    // Splice: tokens before the arguments stay where they are, tokens that
+    // enclose them (UDFs) change size, and tokens after them move
+    const std::size_t first = opens[ region ] + 1;
+    const span edited_span( edited.data(), edited.size() );
+    out.reserve( out.size() + before.size() + fresh.size() );
+    bool spliced = false;
+    for ( std::size_t i = 0; i <= before.size(); ++i ) {
+      std::size_t start = i < before.size() ? before.starts[ i ] : text.size;
+      std::size_t size = i < before.size() ? before.tokens[ i ].size : 0;
+      const bool inside = start >= first && start <= last;
+      if ( !spliced && ( inside || start > last || start + size > first ) ) {
+        for ( std::size_t j = 0; j < fresh.size(); ++j ) {
+          edit_detail::copy_row( fresh, j, out, fresh.tokens[ j ], fresh.starts[ j ],
+                                 edit_detail::move( fresh.values[ j ], edited_span,
+                                                    edited.data(), edited.size(), 0,
+                                                    out.strings ) );
+        }
+        spliced = true;
+      }
+      if ( i == before.size() || inside ) {
+        continue;
+      }
+      if ( start > last ) {
+        start += delta;
+      } else if ( start + size > first ) {
+        size += delta;
+      }
+      edit_detail::copy_row( before, i, out, span( edited.data() + start, size ), start,
+                             edit_detail::move( before.values[ i ], text, edited.data(),
+                                                change.offset + change.deleted, delta,
+                                                out.strings ) );
+    }
+    return true;
+  }
+
+} // xltoken
+
+#endif
@@ -0,0 +1,288 @@
+#ifndef XLTOKEN_FAST_PATH_HPP
+#define XLTOKEN_FAST_PATH_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include "number.hpp"
+#include "token_table.hpp"
+
+namespace xltoken
+{
+
+  // Most formulas in real workbooks are tiny: a cell, a cell on another
+  // sheet, a range, a number, or an aggregate of one range like SUM(A1:A10).
+  // Those shapes are recognized here by hand, in one pass, and tokenized
+  // exactly as the grammar would, so the grammar only sees the rest:
+  //
+  //   formula   = number | reference | function "(" reference ")"
+  //   reference = [ sheet "!" ] cell [ ":" cell ]
+  //   cell      = [$] A-Z{1,4} [$] 0-9+
+  //   sheet     = (A-Z | a-z | _) (A-Z | a-z | 0-9 | _)*
+  //   number    = 0-9+ [ "." 0-9+ ]
+  //
+  // Anything else, even a trailing space, falls back to the grammar, so the
+  // shapes needn't cover every formula that could be taken this way, only
+  // never take one that the grammar would tokenize differently.
+
+  // How many formulas have been tokenized, how many of them took the fast
+  // path, and how many were taken from a cache instead of being parsed.
+  // Counted per thread, in slots on their own cache lines, and summed when
+  // they're read.
+  class fast_path_counts
+  {
+    public:
+      void count( const bool hit )
+      {
+        slot & s = slots_[ this_slot() ];
+        s.formulas.fetch_add( 1, std::memory_order_relaxed );
+        if ( hit ) {
+          s.hits.fetch_add( 1, std::memory_order_relaxed );
+        }
+      }
+
+      void count_cached()
+      {
+        slot & s = slots_[ this_slot() ];
+        s.formulas.fetch_add( 1, std::memory_order_relaxed );
+        s.cached.fetch_add( 1, std::memory_order_relaxed );
+      }
+
+      std::uint64_t formulas() const { return sum( &slot::formulas ); }
+      std::uint64_t hits() const { return sum( &slot::hits ); }
+      std::uint64_t cached() const { return sum( &slot::cached ); }
+
+      void reset()
+      {
+        for ( std::size_t i = 0; i < slots; ++i ) {
+          slots_[ i ].formulas = 0;
+          slots_[ i ].hits = 0;
+          slots_[ i ].cached = 0;
+        }
+      }
+
+    private:
+      static const std::size_t slots = 64;
+
+      struct slot
+      {
+        std::atomic< std::uint64_t > formulas;
+        std::atomic< std::uint64_t > hits;
+        std::atomic< std::uint64_t > cached;
+        char padding[ 64 - 3 * sizeof( std::atomic< std::uint64_t > ) ];
+
+        slot() : formulas( 0 ), hits( 0 ), cached( 0 ) {}
+      };
+
+      slot slots_[ slots ];
+
+      // Threads take slots in turn, so they share one only beyond 64
+      static std::size_t this_slot()
+      {
+        static std::atomic< std::size_t > next( 0 );
+        static thread_local const std::size_t mine = next++ % slots;
+        return mine;
+      }
+
+      std::uint64_t sum( std::atomic< std::uint64_t > slot::* counter ) const
+      {
+        std::uint64_t n = 0;
+        for ( std::size_t i = 0; i < slots; ++i ) {
+          n += ( slots_[ i ].*counter ).load( std::memory_order_relaxed );
+        }
+        return n;
+      }
+  };
+
+  inline fast_path_counts & fast_path()
+  {
+    static fast_path_counts counts;
+    return counts;
+  }
+
+  namespace fast_path_detail
+  {
+
+    // A piece of the formula, for token_table::push
+    struct piece
+    {
+      const char * first;
+      const char * last;
+
+      const char * begin() const { return first; }
+      std::size_t size() const { return last - first; }
+    };
+
+    inline bool is_upper( const char c ) { return c >= 'A' && c <= 'Z'; }
+    inline bool is_lower( const char c ) { return c >= 'a' && c <= 'z'; }
+    inline bool is_digit( const char c ) { return c >= '0' && c <= '9'; }
+
+    inline const char * digits( const char * p, const char * end )
+    {
+      while ( p != end && is_digit( *p ) ) {
+        ++p;
+      }
+      return p;
+    }
+
+    // Each of these returns the end of what it matched at p, or nullptr
+
+    inline const char * cell( const char * p, const char * end )
+    {
+      if ( p != end && *p == '$' ) {
+        ++p;
+      }
+      const char * letters = p;
+      while ( p != end && is_upper( *p ) && p - letters < 4 ) {
+        ++p;
+      }
+      if ( p == letters ) {
+        return nullptr;
+      }
+      if ( p != end && *p == '$' ) {
+        ++p;
+      }
+      const char * row = p;
+      p = digits( p, end );
+      return p == row ? nullptr : p;
+    }
+
+    // Up to its '!'
+    inline const char * sheet( const char * p, const char * end )
+    {
+      if ( p == end || !( is_upper( *p ) || is_lower( *p ) || *p == '_' ) ) {
+        return nullptr;
+      }
+      for ( ++p; p != end; ++p ) {
+        if ( *p == '!' ) {
+          return p;
+        }
+        if ( !( is_upper( *p ) || is_lower( *p ) || is_digit( *p ) || *p == '_' ) ) {
+          return nullptr;
+        }
+      }
+      return nullptr;
+    }
+
+    inline const char * number( const char * p, const char * end )
+    {
+      const char * q = digits( p, end );
+      if ( q == p ) {
+        return nullptr;
+      }
+      if ( q != end && *q == '.' ) {
+        const char * fraction = digits( q + 1, end );
+        return fraction == q + 1 ? nullptr : fraction;
+      }
+      return q;
+    }
+
+    // Functions of one range that are among the commonest of all
+    const char * const aggregates[] = {
+      "SUM", "AVERAGE", "MIN", "MAX", "COUNT", "COUNTA", "PRODUCT", "MEDIAN"
+    };
+
+    // Including its '('
+    inline const char * function( const char * p, const char * end )
+    {
+      const char * paren = p;
+      while ( paren != end && is_upper( *paren ) ) {
+        ++paren;
+      }
+      if ( paren == end || *paren != '(' ) {
+        return nullptr;
+      }
+      const std::size_t length = paren - p;
+      for ( std::size_t i = 0; i < sizeof( aggregates ) / sizeof( aggregates[ 0 ] ); ++i ) {
+        if ( std::strlen( aggregates[ i ] ) == length &&
+             std::memcmp( aggregates[ i ], p, length ) == 0 ) {
+          return paren + 1;
+        }
+      }
+      return nullptr;
+    }
+
+    // A reference, with its pieces, as far as 'end'
+    struct reference
+    {
+      piece sheet_name;   // including its '!', if it has one
+      piece from;
+      piece to;           // if it's a range
+
+      bool match( const char * p, const char * end )
+      {
+        sheet_name.first = sheet_name.last = p;
+        if ( const char * bang = fast_path_detail::sheet( p, end ) ) {
+          sheet_name.last = p = bang + 1;
+        }
+        from.first = p;
+        if ( !( from.last = cell( p, end ) ) ) {
+          return false;
+        }
+        to.first = to.last = from.last;
+        if ( to.first != end && *to.first == ':' ) {
+          ++to.first;
+          if ( !( to.last = cell( to.first, end ) ) ) {
+            return false;
+          }
+        }
+        return to.last == end;
+      }
+
+      void push( token_table & out ) const
+      {
+        if ( sheet_name.size() > 0 ) {
+          out.push_name( "SHEETS", sheet_name, span( sheet_name.first, sheet_name.size() - 1 ) );
+        }
+        out.push( "CELL", from );
+        if ( to.size() > 0 ) {
+          out.push( "RANGE-OP", piece{ from.last, to.first } );
+          out.push( "CELL", to );
+        }
+      }
+    };
+
+  } // fast_path_detail
+
+  // Tokenize a formula of one of the shapes, returning false, having
+  // appended nothing, if it isn't one
+  inline bool tokenize_trivial( const char * data, const std::size_t size, token_table & out )
+  {
+    using namespace fast_path_detail;
+    const char * end = data + size;
+    if ( size == 0 ) {
+      return false;
+    }
+    if ( is_digit( *data ) ) {
+      if ( number( data, end ) != end ) {
+        return false;
+      }
+      out.push( "NUMBER", piece{ data, end } );
+      out.numbers.back() = parse_number( data, end );
+      return true;
+    }
+    // The grammar takes TRUE or FALSE before anything after it but a name
+    // character, e.g. TRUE$1 or TRUE!A1, as a Bool
+    if ( ( size >= 4 && std::memcmp( data, "TRUE", 4 ) == 0 ) ||
+         ( size >= 5 && std::memcmp( data, "FALSE", 5 ) == 0 ) ) {
+      return false;
+    }
+    reference r;
+    if ( const char * open = function( data, end ) ) {
+      if ( end[ -1 ] != ')' || !r.match( open, end - 1 ) ) {
+        return false;
+      }
+      out.push( "EXCEL-FUNCTION", piece{ data, open } );
+      r.push( out );
+      return true;
+    }
+    if ( !r.match( data, end ) ) {
+      return false;
+    }
+    r.push( out );
+    return true;
+  }
+
+} // xltoken
+
+#endif
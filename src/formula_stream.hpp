@@ -0,0 +1,134 @@
+#ifndef XLTOKEN_FORMULA_STREAM_HPP
+#define XLTOKEN_FORMULA_STREAM_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "xltoken.hpp"
+
+namespace xltoken
+{
+
+  // Tokenizes a file of formulas, one to a line, a chunk at a time, so that
+  // files bigger than memory can be tokenized in constant memory.
+  //
+  // Each chunk is the lines in the next 'chunk' bytes of the file.  A line
+  // that runs over the end of the chunk is carried over to the next one,
+  // and the buffer only grows for a line that is longer than a whole chunk.
+  // Formulas are numbered by their line in the file, counting from 1, and
+  // may end with \r\n.
+  class formula_stream
+  {
+    public:
+      // Throws std::runtime_error if the file can't be opened
+      formula_stream( const std::string & path, const std::size_t chunk )
+        : file_( std::fopen( path.c_str(), "rb" ) ),
+          chunk_( std::max< std::size_t >( chunk, 1 ) ),
+          begin_( 0 ), end_( 0 ), line_( 0 ), eof_( false )
+      {
+        if ( file_ == nullptr ) {
+          throw std::runtime_error( "Can't open " + path );
+        }
+      }
+
+      ~formula_stream()
+      {
+        std::fclose( file_ );
+      }
+
+      formula_stream( const formula_stream & ) = delete;
+      formula_stream & operator=( const formula_stream & ) = delete;
+
+      // Tokenize the formulas of the next chunk into a table, whose tokens
+      // are spans of the stream's buffer until the next call.  Returns false
+      // when the file is finished.  Throws std::runtime_error if the file
+      // can't be read.
+      bool next( token_table & t )
+      {
+        // Carry over the partial line from the last chunk
+        const std::size_t carried = end_ - begin_;
+        std::memmove( buffer_.data(), buffer_.data() + begin_, carried );
+        begin_ = 0;
+        end_ = carried;
+
+        // Read until there's a whole line, or the end of the file
+        std::size_t last = 0; // just after the last whole line
+        while ( !eof_ ) {
+          const std::size_t from = end_;
+          buffer_.resize( std::max( buffer_.size(), end_ + chunk_ ) );
+          end_ += std::fread( buffer_.data() + end_, 1, chunk_, file_ );
+          if ( std::ferror( file_ ) ) {
+            throw std::runtime_error( "Can't read the formulas" );
+          }
+          eof_ = std::feof( file_ ) != 0;
+          const char * newline = find_last( buffer_.data() + from, buffer_.data() + end_ );
+          if ( newline != nullptr ) {
+            last = newline - buffer_.data() + 1;
+            break;
+          }
+        }
+        if ( eof_ ) {
+          last = end_;
+        }
+        if ( last == 0 ) {
+          return false;
+        }
+
+        // The lines are counted apart from line_, which moves on with
+        // begin_ only once all of them have been tokenized, so that they're
+        // never numbered twice
+        int line = line_;
+        const char * p = buffer_.data();
+        const char * const end = p + last;
+        while ( p < end ) {
+          const char * eol = static_cast< const char * >( std::memchr( p, '\n', end - p ) );
+          const char * next = eol == nullptr ? end : eol + 1;
+          if ( eol == nullptr ) {
+            eol = end;
+          }
+          if ( eol > p && eol[ -1 ] == '\r' ) {
+            --eol;
+          }
+          t.formula = ++line;
+          try {
+            if ( eol > p ) {
+              parse_formula( p, eol - p, t );
+            }
+          } catch ( const parse_error & ) {
+          }
+          p = next;
+        }
+        line_ = line;
+        begin_ = last;
+        return true;
+      }
+
+      // How many lines have been read
+      int lines() const { return line_; }
+
+    private:
+      std::FILE * file_;
+      std::vector< char > buffer_;
+      std::size_t chunk_;
+      std::size_t begin_;  // of the lines that haven't been tokenized
+      std::size_t end_;    // of what's been read
+      int line_;
+      bool eof_;
+
+      static const char * find_last( const char * begin, const char * end )
+      {
+        while ( end != begin ) {
+          if ( *--end == '\n' ) {
+            return end;
+          }
+        }
+        return nullptr;
+      }
+  };
+
+} // xltoken
+
+#endif
@@ -0,0 +1,250 @@
+// Hunts for formulas that take the grammar super-linear time.  The cost of
+// an input is how many rules it starts per byte, which is what backtracking
+// multiplies, and its ratio is that over the cost of ordinary formulas from
+// the generator.  Inputs that are slower than any seen before are saved to
+// a directory as a regression corpus, with their costs in costs.tsv.
+//
+// With libFuzzer, the cost is fed back as extra counters, one per bucket of
+// cost, so an input that reaches a new bucket is new coverage and is kept:
+//
+//   clang++ -std=c++11 -O2 -g -fsanitize=fuzzer -DXLTOKEN_LIBFUZZER -I.. perf_fuzz.cc -o perf_fuzz
+//   XLTOKEN_SLOW_DIR=slow ./perf_fuzz -max_len=256 corpus/
+//
+// Without it, the harness mutates inputs itself, keeping a population of the
+// costliest:
+//
+//   clang++ -std=c++11 -O2 -I.. perf_fuzz.cc -o perf_fuzz
+//   ./perf_fuzz [iterations] [slow directory] [max length] [seed]
+//
+// Every parse runs within the formula budget, so an input that would take
+// for ever is cut off at it, and is the costliest possible.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "xltoken.hpp"
+#include "generator.hpp"
+
+namespace
+{
+
+  const std::size_t budget = 20000000;
+
+  // Rules started per byte
+  double cost( const std::string & input, std::size_t & steps )
+  {
+    xltoken::formula_budget().steps = budget;
+    xltoken::token_table t;
+    try {
+      xltoken::parse_formula( input.data(), input.size(), t );
+    } catch ( const tao::pegtl::parse_error & ) {
+    }
+    steps = std::min( t.steps, budget );
+    return static_cast< double >( steps ) / std::max< std::size_t >( input.size(), 1 );
+  }
+
+  // The median cost of ordinary formulas
+  double baseline()
+  {
+    xltoken::corpus_shape shape;
+    std::vector< double > costs;
+    for ( int depth = 1; depth <= 4; ++depth ) {
+      shape.depth = depth;
+      xltoken::formula_generator generator( shape, depth );
+      for ( int i = 0; i < 250; ++i ) {
+        std::size_t steps;
+        costs.push_back( cost( generator.next(), steps ) );
+      }
+    }
+    std::nth_element( costs.begin(), costs.begin() + costs.size() / 2, costs.end() );
+    return costs[ costs.size() / 2 ];
+  }
+
+  // Saves inputs that are slower than any saved before
+  class slow_cases
+  {
+    public:
+      explicit slow_cases( const std::string & directory )
+        : directory_( directory ), baseline_( baseline() ), worst_( 1 )
+      {
+        mkdir( directory_.c_str(), 0777 );
+      }
+
+      double ratio( const double c ) const { return c / baseline_; }
+
+      void record( const std::string & input, const std::size_t steps, const double c )
+      {
+        const double r = ratio( c );
+        if ( r <= worst_ * 1.05 ) {
+          return;
+        }
+        worst_ = r;
+        char name[ 64 ];
+        std::snprintf( name, sizeof( name ), "slow-%010.1fx-%016llx.txt", r,
+                       static_cast< unsigned long long >( std::hash< std::string >()( input ) ) );
+        const std::string path = directory_ + "/" + name;
+        if ( std::FILE * f = std::fopen( path.c_str(), "wb" ) ) {
+          std::fwrite( input.data(), 1, input.size(), f );
+          std::fclose( f );
+        }
+        if ( std::FILE * f = std::fopen( ( directory_ + "/costs.tsv" ).c_str(), "a" ) ) {
+          std::fprintf( f, "%s\t%zu\t%zu\t%.1f\n", name, input.size(), steps, r );
+          std::fclose( f );
+        }
+        std::printf( "ratio %.1f, %zu bytes: %s\n", r, input.size(), input.c_str() );
+        std::fflush( stdout );
+      }
+
+    private:
+      std::string directory_;
+      double baseline_;
+      double worst_;
+  };
+
+  const char * slow_directory()
+  {
+    const char * d = std::getenv( "XLTOKEN_SLOW_DIR" );
+    return d != nullptr ? d : "slow";
+  }
+
+} // namespace
+
+#ifdef XLTOKEN_LIBFUZZER
+
+// One counter per bucket of cost, on a log scale, which libFuzzer resets
+// before every input
+__attribute__( ( used, section( "__libfuzzer_extra_counters" ) ) )
+static std::uint8_t cost_counters[ 64 ];
+
+extern "C" int LLVMFuzzerTestOneInput( const std::uint8_t * data, std::size_t size )
+{
+  static slow_cases slow( slow_directory() );
+  const std::string input( reinterpret_cast< const char * >( data ), size );
+  std::size_t steps;
+  const double c = cost( input, steps );
+  const double r = slow.ratio( c );
+  int bucket = 0;
+  for ( double b = 1; b < r && bucket < 63; b *= 1.25 ) {
+    ++bucket;
+  }
+  for ( int b = 0; b <= bucket; ++b ) {
+    cost_counters[ b ] = 1;
+  }
+  slow.record( input, steps, c );
+  return 0;
+}
+
+#else
+
+namespace
+{
+
+  // Pieces of formulas to insert, which the grammar has to decide between
+  const char * const pieces[] = {
+    "(", ")", ",", "!", ":", "'", "\"", "$", "A1", "B2:C3", "SUM(", "IF(",
+    "INDEX(", "[1]", "{", "}", ";", " ", "#REF!", "1", "Sheet1!", "'A B'!",
+    "A:A", "1:1", "+", "-", "&", "TRUE", "_xll.", "Name", "."
+  };
+
+  class mutator
+  {
+    public:
+      explicit mutator( const std::uint64_t seed ) : state_( seed ) {}
+
+      std::uint64_t below( const std::uint64_t n )
+      {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return state_ % n;
+      }
+
+      std::string mutate( std::string s, const std::size_t max_length )
+      {
+        for ( std::uint64_t m = 1 + below( 4 ); m > 0; --m ) {
+          const std::size_t at = below( s.size() + 1 );
+          switch ( below( 4 ) ) {
+            case 0:   // insert a piece
+              s.insert( at, pieces[ below( sizeof( pieces ) / sizeof( pieces[ 0 ] ) ) ] );
+              break;
+            case 1:   // delete a few characters
+              s.erase( at, 1 + below( 4 ) );
+              break;
+            case 2: { // repeat a substring, which nests what's in it again
+              const std::size_t n = 1 + below( std::max< std::size_t >( s.size() - std::min( at, s.size() ), 1 ) );
+              s.insert( at, s.substr( at, n ) );
+              break;
+            }
+            default:  // replace a character with a piece
+              if ( at < s.size() ) {
+                s.replace( at, 1, pieces[ below( sizeof( pieces ) / sizeof( pieces[ 0 ] ) ) ] );
+              }
+          }
+        }
+        if ( s.size() > max_length ) {
+          s.resize( max_length );
+        }
+        return s.empty() ? std::string( "(" ) : s;
+      }
+
+    private:
+      std::uint64_t state_;
+  };
+
+  struct candidate
+  {
+    std::string input;
+    double cost;
+  };
+
+} // namespace
+
+int main( int argc, char * argv[] )
+{
+  const long iterations = argc > 1 ? std::atol( argv[ 1 ] ) : 100000;
+  const std::string directory = argc > 2 ? argv[ 2 ] : slow_directory();
+  const std::size_t max_length = argc > 3 ? std::atol( argv[ 3 ] ) : 256;
+  const std::uint64_t seed = argc > 4 ? std::atol( argv[ 4 ] ) : 1;
+
+  slow_cases slow( directory );
+  mutator m( seed | 1 );
+
+  // Start from ordinary formulas
+  std::vector< candidate > population;
+  xltoken::corpus_shape shape;
+  shape.depth = 1;
+  xltoken::formula_generator generator( shape, seed );
+  while ( population.size() < 32 ) {
+    std::string input = generator.next();
+    if ( input.size() > max_length ) {
+      continue;
+    }
+    std::size_t steps;
+    const double c = cost( input, steps );
+    population.push_back( candidate{ input, c } );
+  }
+
+  // Mutate the costlier of two, and keep the child if it beats the cheapest
+  for ( long i = 0; i < iterations; ++i ) {
+    const candidate & a = population[ m.below( population.size() ) ];
+    const candidate & b = population[ m.below( population.size() ) ];
+    const std::string child = m.mutate( a.cost > b.cost ? a.input : b.input, max_length );
+    std::size_t steps;
+    const double c = cost( child, steps );
+    std::vector< candidate >::iterator cheapest = std::min_element(
+      population.begin(), population.end(),
+      []( const candidate & x, const candidate & y ) { return x.cost < y.cost; } );
+    if ( c > cheapest->cost ) {
+      *cheapest = candidate{ child, c };
+    }
+    slow.record( child, steps, c );
+  }
+  return 0;
+}
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef XLTOKEN_GENERATOR_HPP
+#define XLTOKEN_GENERATOR_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace xltoken
+{
+
+  // Random formulas of a known shape, for benchmarks, from the constructs of
+  // the grammar: function calls, parentheses, operators, references with and
+  // without sheets, and constants.  Every formula parses, by construction.
+  //
+  // A formula is a chain of nested calls or parentheses exactly 'depth'
+  // deep, each of whose other arguments and operands is a leaf: a reference
+  // or a constant.  So its length grows linearly with depth, and any worse
+  // growth of the time to tokenize it is the parser's.
+  //
+  // The same seed gives the same formulas on every platform, so the random
+  // numbers are drawn by hand rather than by <random>'s distributions.
+
+  struct corpus_shape
+  {
+    int depth;           // of nested calls and parentheses
+    double functions;    // chance that a nesting is a call, not parentheses
+    double references;   // chance that a leaf is a reference, not a constant
+    int string_length;   // of text constants
+    double sheets;       // chance that a reference has a sheet
+
+    corpus_shape()
+      : depth( 2 ), functions( 0.8 ), references( 0.5 ), string_length( 8 ), sheets( 0.2 )
+    {}
+  };
+
+  namespace generator_detail
+  {
+
+    struct function
+    {
+      const char * name;
+      int arguments;
+    };
+
+    const function functions[] = {
+      { "SUM", 2 }, { "MAX", 3 }, { "MIN", 2 }, { "AVERAGE", 3 }, { "IF", 3 },
+      { "IFERROR", 2 }, { "ROUND", 2 }, { "AND", 2 }, { "OR", 3 },
+      { "VLOOKUP", 4 }, { "INDEX", 3 }, { "CONCATENATE", 3 }, { "LEFT", 2 },
+      { "ABS", 1 }, { "COUNTIF", 2 }, { "CHOOSE", 3 }
+    };
+
+    const char * const operators[] = {
+      "+", "-", "*", "/", "^", "&", "=", "<>", "<", ">", "<=", ">="
+    };
+
+    const char * const sheets[] = {
+      "Sheet1!", "Sheet2!", "'Data Sheet'!", "'It''s'!", "Inputs!"
+    };
+
+    const char text_characters[] =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 .,;:-";
+
+  } // generator_detail
+
+  class formula_generator
+  {
+    public:
+      formula_generator( const corpus_shape & shape, const std::uint64_t seed )
+        : shape_( shape ), state_( seed )
+      {}
+
+      std::string next()
+      {
+        std::string out;
+        expression( shape_.depth, out );
+        return out;
+      }
+
+    private:
+      corpus_shape shape_;
+      std::uint64_t state_;
+
+      // splitmix64
+      std::uint64_t draw()
+      {
+        std::uint64_t z = ( state_ += 0x9e3779b97f4a7c15ULL );
+        z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+        z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+        return z ^ ( z >> 31 );
+      }
+
+      std::uint64_t below( const std::uint64_t n ) { return draw() % n; }
+
+      bool chance( const double p )
+      {
+        return static_cast< double >( draw() >> 11 ) / 9007199254740992.0 < p;
+      }
+
+      // One to three operands, one of which nests 'depth' deep
+      void expression( const int depth, std::string & out )
+      {
+        using namespace generator_detail;
+        const std::uint64_t operands = 1 + below( 3 );
+        const std::uint64_t deep = below( operands );
+        for ( std::uint64_t i = 0; i < operands; ++i ) {
+          if ( i > 0 ) {
+            out += operators[ below( sizeof( operators ) / sizeof( operators[ 0 ] ) ) ];
+          }
+          operand( i == deep ? depth : 0, out );
+        }
+      }
+
+      void operand( const int depth, std::string & out )
+      {
+        using namespace generator_detail;
+        if ( depth <= 0 ) {
+          leaf( out );
+        } else if ( chance( shape_.functions ) ) {
+          const function & f = functions[ below( sizeof( functions ) / sizeof( functions[ 0 ] ) ) ];
+          const int deep = below( f.arguments );
+          out += f.name;
+          out += '(';
+          for ( int a = 0; a < f.arguments; ++a ) {
+            if ( a > 0 ) {
+              out += ',';
+            }
+            expression( a == deep ? depth - 1 : 0, out );
+          }
+          out += ')';
+        } else {
+          out += '(';
+          expression( depth - 1, out );
+          out += ')';
+        }
+      }
+
+      void leaf( std::string & out )
+      {
+        if ( chance( shape_.references ) ) {
+          reference( out );
+          return;
+        }
+        switch ( below( 3 ) ) {
+          case 0:
+            out += std::to_string( below( 100000 ) );
+            if ( chance( 0.3 ) ) {
+              out += '.';
+              out += std::to_string( below( 1000 ) );
+            }
+            break;
+          case 1:
+            text( out );
+            break;
+          default:
+            out += chance( 0.5 ) ? "TRUE" : "FALSE";
+        }
+      }
+
+      void text( std::string & out )
+      {
+        using namespace generator_detail;
+        out += '"';
+        for ( int i = 0; i < shape_.string_length; ++i ) {
+          if ( below( 32 ) == 0 ) {
+            out += "\"\"";
+          } else {
+            out += text_characters[ below( sizeof( text_characters ) - 1 ) ];
+          }
+        }
+        out += '"';
+      }
+
+      void reference( std::string & out )
+      {
+        using namespace generator_detail;
+        if ( chance( shape_.sheets ) ) {
+          out += sheets[ below( sizeof( sheets ) / sizeof( sheets[ 0 ] ) ) ];
+        }
+        cell( out );
+        if ( chance( 0.25 ) ) {
+          out += ':';
+          cell( out );
+        }
+      }
+
+      // Mostly near the top left, as in real sheets
+      void cell( std::string & out )
+      {
+        const std::uint64_t col = chance( 0.9 ) ? 1 + below( 26 ) : 1 + below( 16384 );
+        const std::uint64_t row = chance( 0.9 ) ? 1 + below( 1000 ) : 1 + below( 1048576 );
+        if ( chance( 0.2 ) ) {
+          out += '$';
+        }
+        char letters[ 3 ];
+        int n = 0;
+        for ( std::uint64_t c = col; c > 0; c = ( c - 1 ) / 26 ) {
+          letters[ n++ ] = 'A' + ( c - 1 ) % 26;
+        }
+        while ( n > 0 ) {
+          out += letters[ --n ];
+        }
+        if ( chance( 0.2 ) ) {
+          out += '$';
+        }
+        out += std::to_string( row );
+      }
+  };
+
+} // xltoken
+
+#endif
@@ -0,0 +1,378 @@
+#ifndef XLTOKEN_GRAPH_HPP
+#define XLTOKEN_GRAPH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "xltoken.hpp"
+#include "names.hpp"
+#include "references.hpp"
+
+namespace xltoken
+{
+
+  // Sheet of a reference in a global defined name that has no sheet prefix,
+  // which means the sheet of whichever formula uses the name
+  const int sheet_of_formula = -1;
+
+  // Sheet of a reference to another workbook
+  const int external_sheet = -2;
+
+  // Visit the references in the tokens [begin, end) of one formula: CELL,
+  // CELL:CELL, VERTICAL-RANGE and HORIZONTAL-RANGE, each with the sheet of its
+  // prefix or else the formula's own sheet, and NAME tokens that resolved to a
+  // definition.  The visitor has two methods:
+  // * reference( const area & )
+  // * name( int definition )
+  //
+  // Sheets are interned in 'sheets', copied into 'owner'.  A 3D prefix such as
+  // Sheet1:Sheet3! is treated as a sheet of its own.  References to other
+  // workbooks, e.g. [1]Sheet1!A1, have the sheet external_sheet.  INDIRECT()
+  // and OFFSET() can't be known without evaluating them, so are ignored.
+  template< typename Visitor >
+    void visit_references( const token_table & t,
+                           const std::size_t begin,
+                           const std::size_t end,
+                           const int sheet,
+                           const std::vector< int > & definitions,
+                           interner & sheets,
+                           arena & owner,
+                           Visitor & visitor )
+    {
+      int prefix = sheet;
+      const char * prefix_end = nullptr; // the prefix applies to a token here
+      for ( std::size_t i = begin; i < end; ++i ) {
+        const std::string & type = t.types[ i ];
+        const span & token = t.tokens[ i ];
+        if ( type == "SHEETS" || type == "SHEETS-QUOTED" ) {
+          if ( t.starts[ i ] > 0 && token.data[ -1 ] == ']' ) {
+            prefix = external_sheet;
+          } else {
+            prefix = sheets.intern( t.names.strings()[ t.name_ids[ i ] - 1 ], owner );
+          }
+          prefix_end = token.data + token.size;
+          continue;
+        }
+        const int s = token.data == prefix_end ? prefix : sheet;
+        area a;
+        a.sheet = s;
+        if ( type == "CELL" ) {
+          cell_reference first;
+          if ( !parse_cell( token, first ) ) {
+            continue;
+          }
+          a.first_row = a.last_row = first.row.index;
+          a.first_col = a.last_col = first.col.index;
+          // A1:B2 is three tokens
+          cell_reference last;
+          if ( i + 2 < end
+               && t.types[ i + 1 ] == "RANGE-OP"
+               && t.types[ i + 2 ] == "CELL"
+               && t.tokens[ i + 1 ].data == token.data + token.size
+               && parse_cell( t.tokens[ i + 2 ], last ) ) {
+            a.first_row = std::min( first.row.index, last.row.index );
+            a.last_row = std::max( first.row.index, last.row.index );
+            a.first_col = std::min( first.col.index, last.col.index );
+            a.last_col = std::max( first.col.index, last.col.index );
+            i += 2;
+          }
+        } else if ( type == "VERTICAL-RANGE" ) {
+          coordinate first, last;
+          if ( !parse_columns( token, first, last ) ) {
+            continue;
+          }
+          a.first_row = 1;
+          a.last_row = max_rows;
+          a.first_col = std::min( first.index, last.index );
+          a.last_col = std::max( first.index, last.index );
+        } else if ( type == "HORIZONTAL-RANGE" ) {
+          coordinate first, last;
+          if ( !parse_rows( token, first, last ) ) {
+            continue;
+          }
+          a.first_row = std::min( first.index, last.index );
+          a.last_row = std::max( first.index, last.index );
+          a.first_col = 1;
+          a.last_col = max_cols;
+        } else if ( type == "NAME" ) {
+          if ( definitions[ i ] != 0 ) {
+            visitor.name( definitions[ i ] );
+          }
+          continue;
+        } else {
+          continue;
+        }
+        if ( !in_sheet( a ) ) {
+          continue;
+        }
+        visitor.reference( a );
+      }
+    }
+
+  // The dependency graph of the formulas of a workbook.
+  //
+  // Vertices are, in order:
+  // * formula cells, in the order they were added
+  // * areas, i.e. every other distinct reference: ranges, and cells that
+  //   don't have formulas.
+  //
+  // Ranges aren't expanded to every cell.  Instead, a formula cell that refers
+  // to a range has an edge to the range's vertex, which has an edge to each
+  // formula cell in the range.  So SUM(A:A) in a thousand formulas costs one
+  // vertex and a thousand edges, plus one edge per formula in column A.
+  //
+  // Edges run from each vertex to its precedents, in compressed sparse row
+  // form: the precedents of vertex v are precedents[offsets[v]] up to
+  // precedents[offsets[v + 1]].
+  class dependency_graph
+  {
+    public:
+      // A formula cell.  The sheet and formula must outlive build().  Throws
+      // std::runtime_error if the cell isn't within a worksheet.
+      void add( const span & sheet, const int row, const int col, const span & formula )
+      {
+        if ( !in_sheet( row, col ) ) {
+          throw std::runtime_error( "Formula cells must be within the worksheet" );
+        }
+        cell_sheets_.push_back( sheets_.intern( sheet, strings_ ) );
+        rows_.push_back( row );
+        cols_.push_back( col );
+        formulas_.push_back( formula );
+      }
+
+      // Tokenize the formulas, 'batch' at a time so that only one batch of
+      // tokens is in memory at once, and link them.
+      void build( const name_table & names, const std::size_t batch = 65536 )
+      {
+        index_cells();
+        expand_names( names );
+
+        const std::size_t n = cells();
+        offsets_.assign( 1, 0 );
+        precedents_.clear();
+        std::vector< span > formula_sheets;
+        std::vector< int > definitions;
+        cell_visitor visitor( *this );
+        for ( std::size_t first = 0; first < n; first += batch ) {
+          const std::size_t last = std::min( n, first + batch );
+          token_table table;
+          formula_sheets.clear();
+          for ( std::size_t c = first; c < last; ++c ) {
+            table.formula = c - first + 1;
+            formula_sheets.push_back( sheets_.strings()[ cell_sheets_[ c ] - 1 ] );
+            if ( !formulas_[ c ].is_na() ) {
+              // A malformed formula leaves its cell without precedents
+              const std::size_t before = table.size();
+              try {
+                parse_formula( formulas_[ c ].data, formulas_[ c ].size, table );
+              } catch ( const parse_error & ) {
+                table.truncate( before );
+              }
+            }
+          }
+          names.resolve( table, formula_sheets, definitions );
+
+          // Tokens are in formula order, so walk them formula by formula
+          std::size_t i = 0;
+          for ( std::size_t c = first; c < last; ++c ) {
+            std::size_t j = i;
+            while ( j < table.size()
+                    && table.formula_ids[ j ] == static_cast< int >( c - first + 1 ) ) {
+              ++j;
+            }
+            visitor.sheet = cell_sheets_[ c ];
+            visitor.targets.clear();
+            visit_references( table, i, j, cell_sheets_[ c ], definitions,
+                              sheets_, strings_, visitor );
+            std::sort( visitor.targets.begin(), visitor.targets.end() );
+            visitor.targets.erase( std::unique( visitor.targets.begin(),
+                                                visitor.targets.end() ),
+                                   visitor.targets.end() );
+            precedents_.insert( precedents_.end(),
+                                visitor.targets.begin(), visitor.targets.end() );
+            offsets_.push_back( precedents_.size() );
+            i = j;
+          }
+        }
+
+        link_areas();
+      }
+
+      int cells() const { return cell_sheets_.size(); }
+      int vertices() const { return cells() + areas_.size(); }
+
+      // The area of vertex cells() + i
+      const std::vector< area > & areas() const { return areas_; }
+
+      // The sheet, row and column of formula cell vertex v
+      int sheet( const int v ) const { return cell_sheets_[ v ]; }
+      int row( const int v ) const { return rows_[ v ]; }
+      int col( const int v ) const { return cols_[ v ]; }
+
+      const interner & sheets() const { return sheets_; }
+      const std::vector< int > & offsets() const { return offsets_; }
+      const std::vector< int > & precedents() const { return precedents_; }
+
+    private:
+      arena strings_;
+      interner sheets_;
+      std::vector< int > cell_sheets_;
+      std::vector< int > rows_;
+      std::vector< int > cols_;
+      std::vector< span > formulas_;
+
+      // Formula cells by cell_key(), for lookups of cells and of areas
+      std::vector< std::pair< std::uint64_t, int > > index_;
+
+      std::vector< std::vector< area > > name_areas_; // by definition - 1
+      std::unordered_map< area, int, area_hash > area_ids_;
+      std::vector< area > areas_;
+      std::vector< int > offsets_;
+      std::vector< int > precedents_;
+
+      // Collects the precedents of one formula cell
+      struct cell_visitor
+      {
+        dependency_graph & graph;
+        int sheet;
+        std::vector< int > targets;
+
+        explicit cell_visitor( dependency_graph & g ) : graph( g ), sheet( 0 ) {}
+
+        void reference( const area & a )
+        {
+          targets.push_back( graph.vertex( a ) );
+        }
+
+        void name( const int definition )
+        {
+          const std::vector< area > & areas = graph.name_areas_[ definition - 1 ];
+          for ( std::size_t k = 0; k < areas.size(); ++k ) {
+            area a = areas[ k ];
+            if ( a.sheet == sheet_of_formula ) {
+              a.sheet = sheet;
+            }
+            targets.push_back( graph.vertex( a ) );
+          }
+        }
+      };
+
+      // Collects the references of one definition
+      struct name_visitor
+      {
+        std::vector< area > & areas;
+        explicit name_visitor( std::vector< area > & a ) : areas( a ) {}
+        void reference( const area & a ) { areas.push_back( a ); }
+        void name( const int ) {} // via the closure instead
+      };
+
+      void index_cells()
+      {
+        index_.clear();
+        index_.reserve( cells() );
+        for ( int c = 0; c < cells(); ++c ) {
+          index_.push_back( std::make_pair(
+            cell_key( cell_sheets_[ c ], rows_[ c ], cols_[ c ] ), c ) );
+        }
+        std::sort( index_.begin(), index_.end() );
+      }
+
+      // The formula cell at a position, or -1
+      int find_cell( const int sheet, const int row, const int col ) const
+      {
+        const std::uint64_t key = cell_key( sheet, row, col );
+        std::vector< std::pair< std::uint64_t, int > >::const_iterator it =
+          std::lower_bound( index_.begin(), index_.end(), std::make_pair( key, -1 ) );
+        return it != index_.end() && it->first == key ? it->second : -1;
+      }
+
+      // The vertex of a reference: a formula cell, or an area
+      int vertex( const area & a )
+      {
+        if ( a.is_cell() && a.sheet > 0 ) {
+          const int c = find_cell( a.sheet, a.first_row, a.first_col );
+          if ( c != -1 ) {
+            return c;
+          }
+        }
+        std::unordered_map< area, int, area_hash >::const_iterator it = area_ids_.find( a );
+        if ( it != area_ids_.end() ) {
+          return it->second;
+        }
+        const int v = cells() + areas_.size();
+        area_ids_.insert( std::make_pair( a, v ) );
+        areas_.push_back( a );
+        return v;
+      }
+
+      // The references of every definition, including those of the
+      // definitions it refers to.  A global definition's unprefixed references
+      // are to the sheet of the formula that uses it.
+      void expand_names( const name_table & names )
+      {
+        const token_table & t = names.definitions();
+        std::vector< std::vector< area > > own( names.size() );
+        std::size_t i = 0;
+        for ( int d = 1; d <= names.size(); ++d ) {
+          std::size_t j = i;
+          while ( j < t.size() && t.formula_ids[ j ] == d ) {
+            ++j;
+          }
+          const span & scope = names.sheet( d );
+          const int sheet = scope.size == 0
+                            ? sheet_of_formula
+                            : sheets_.intern( scope, strings_ );
+          name_visitor visitor( own[ d - 1 ] );
+          visit_references( t, i, j, sheet, names.references(),
+                            sheets_, strings_, visitor );
+          i = j;
+        }
+        name_areas_.assign( names.size(), std::vector< area >() );
+        for ( int d = 1; d <= names.size(); ++d ) {
+          std::vector< area > & areas = name_areas_[ d - 1 ];
+          areas = own[ d - 1 ];
+          const std::vector< int > & closure = names.closure( d );
+          for ( std::size_t k = 0; k < closure.size(); ++k ) {
+            if ( closure[ k ] != d ) {
+              const std::vector< area > & more = own[ closure[ k ] - 1 ];
+              areas.insert( areas.end(), more.begin(), more.end() );
+            }
+          }
+        }
+      }
+
+      // Edges from each area to the formula cells in it.  The cells of a
+      // column of an area are contiguous in the index, and columns without
+      // formulas are skipped by searching for the next one.
+      void link_areas()
+      {
+        for ( std::size_t k = 0; k < areas_.size(); ++k ) {
+          const area & a = areas_[ k ];
+          const std::size_t first = precedents_.size();
+          int col = a.first_col;
+          while ( a.sheet > 0 && col <= a.last_col ) {
+            std::vector< std::pair< std::uint64_t, int > >::const_iterator it =
+              std::lower_bound( index_.begin(), index_.end(),
+                                std::make_pair( cell_key( a.sheet, a.first_row, col ), -1 ) );
+            const std::uint64_t end = cell_key( a.sheet, a.last_row, col );
+            for ( ; it != index_.end() && it->first <= end; ++it ) {
+              precedents_.push_back( it->second );
+            }
+            if ( it == index_.end() || ( it->first >> 36 ) != static_cast< std::uint64_t >( a.sheet ) ) {
+              break;
+            }
+            // The next column with a formula in it, on or after the next one
+            col = std::max( col + 1, static_cast< int >( ( it->first >> 21 ) & 0x7FFF ) );
+          }
+          std::sort( precedents_.begin() + first, precedents_.end() );
+          offsets_.push_back( precedents_.size() );
+        }
+      }
+  };
+
+} // xltoken
+
+#endif
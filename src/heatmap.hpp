@@ -0,0 +1,222 @@
+#ifndef XLTOKEN_HEATMAP_HPP
+#define XLTOKEN_HEATMAP_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "xltoken.hpp"
+
+namespace xltoken
+{
+
+  // Where the grammar backtracks.  A corpus of formulas is parsed with a
+  // control that follows every rule, and when a rule fails, the bytes that
+  // it and the rules within it had matched before it failed are the bytes
+  // it discarded, which something else must parse again.  Rules that
+  // discard the most are where changes to the grammar would pay.
+
+  // What one rule did across the corpus.  Its worst formula is the one in
+  // which it discarded the most relative to the formula's length, its
+  // ratio, and the worst position is where, in that formula, the attempt
+  // that discarded the most began.
+  struct rule_heat
+  {
+    std::string rule;
+    std::uint64_t starts;
+    std::uint64_t successes;
+    std::uint64_t failures;
+    std::uint64_t discarded;   // bytes
+    double worst_ratio;
+    int worst_formula;         // counting from 1
+    std::size_t worst_position; // counting from 0
+  };
+
+  namespace heatmap_detail
+  {
+
+    // The name of a rule, made once, whose address identifies the rule
+    template< typename Rule >
+      const std::string & rule_name()
+      {
+        static const std::string name = internal::demangle< Rule >();
+        return name;
+      }
+
+    class recorder
+    {
+      public:
+        explicit recorder( const std::size_t budget ) : budget_( budget ) {}
+
+        void begin_formula( const int formula, const std::size_t size )
+        {
+          formula_ = formula;
+          size_ = std::max< std::size_t >( size, 1 );
+          steps_ = 0;
+          frames_.clear();
+          this_formula_.clear();
+        }
+
+        void start( const std::string & rule, const std::size_t at )
+        {
+          if ( budget_ != 0 && ++steps_ > budget_ ) {
+            throw budget_exceeded();
+          }
+          frames_.push_back( frame{ &rule, at, at } );
+          ++totals_[ &rule ].starts;
+        }
+
+        void success( const std::size_t at )
+        {
+          frame f = pop( at );
+          ++totals_[ f.rule ].successes;
+        }
+
+        void failure()
+        {
+          frame f = pop( 0 );
+          const std::uint64_t discarded = f.furthest - f.start;
+          ++totals_[ f.rule ].failures;
+          totals_[ f.rule ].discarded += discarded;
+          attempt & a = this_formula_[ f.rule ];
+          a.discarded += discarded;
+          if ( discarded > a.most ) {
+            a.most = discarded;
+            a.at = f.start;
+          }
+        }
+
+        // Fold the formula's rules into the worst cases
+        void end_formula()
+        {
+          for ( std::unordered_map< const std::string *, attempt >::const_iterator it =
+                  this_formula_.begin(); it != this_formula_.end(); ++it ) {
+            total & t = totals_[ it->first ];
+            const double ratio = static_cast< double >( it->second.discarded ) / size_;
+            if ( ratio > t.worst_ratio ) {
+              t.worst_ratio = ratio;
+              t.worst_formula = formula_;
+              t.worst_position = it->second.at;
+            }
+          }
+        }
+
+        // The rules, those that discarded most first
+        void report( std::vector< rule_heat > & out ) const
+        {
+          out.clear();
+          for ( std::unordered_map< const std::string *, total >::const_iterator it =
+                  totals_.begin(); it != totals_.end(); ++it ) {
+            const total & t = it->second;
+            out.push_back( rule_heat{ *it->first, t.starts, t.successes, t.failures,
+                                      t.discarded, t.worst_ratio, t.worst_formula,
+                                      t.worst_position } );
+          }
+          std::sort( out.begin(), out.end(), []( const rule_heat & a, const rule_heat & b ) {
+            return a.discarded != b.discarded ? a.discarded > b.discarded : a.rule < b.rule;
+          } );
+        }
+
+      private:
+        struct frame
+        {
+          const std::string * rule;
+          std::size_t start;
+          std::size_t furthest;  // that it or a rule within it has matched to
+        };
+
+        struct total
+        {
+          std::uint64_t starts = 0;
+          std::uint64_t successes = 0;
+          std::uint64_t failures = 0;
+          std::uint64_t discarded = 0;
+          double worst_ratio = 0;
+          int worst_formula = 0;
+          std::size_t worst_position = 0;
+        };
+
+        struct attempt
+        {
+          std::uint64_t discarded = 0;
+          std::uint64_t most = 0;
+          std::size_t at = 0;
+        };
+
+        std::size_t budget_;
+        int formula_ = 0;
+        std::size_t size_ = 1;
+        std::size_t steps_ = 0;
+        std::vector< frame > frames_;
+        std::unordered_map< const std::string *, total > totals_;
+        std::unordered_map< const std::string *, attempt > this_formula_;
+
+        // Finish the innermost rule, which matched up to 'at' if it
+        // succeeded, and pass how far it got to the rule around it
+        frame pop( const std::size_t at )
+        {
+          frame f = frames_.back();
+          frames_.pop_back();
+          f.furthest = std::max( f.furthest, at );
+          if ( !frames_.empty() ) {
+            frames_.back().furthest = std::max( frames_.back().furthest, f.furthest );
+          }
+          return f;
+        }
+    };
+
+  } // heatmap_detail
+
+  template< typename Rule >
+    struct heat_control : normal< Rule >
+    {
+      template< typename Input >
+        static void start( const Input & in, heatmap_detail::recorder & r )
+        {
+          r.start( heatmap_detail::rule_name< Rule >(), in.byte() );
+        }
+
+      template< typename Input >
+        static void success( const Input & in, heatmap_detail::recorder & r )
+        {
+          r.success( in.byte() );
+        }
+
+      template< typename Input >
+        static void failure( const Input &, heatmap_detail::recorder & r )
+        {
+          r.failure();
+        }
+    };
+
+  // Parse a corpus of formulas, without tokenizing them, and report what
+  // each rule discarded.  Formulas that run out of the parse budget count
+  // as far as they got, and 'abandoned' counts them.
+  inline void grammar_heatmap( const std::vector< span > & formulas,
+                               std::vector< rule_heat > & out,
+                               std::size_t & abandoned )
+  {
+    heatmap_detail::recorder r( formula_budget().steps.load() );
+    abandoned = 0;
+    for ( std::size_t f = 0; f < formulas.size(); ++f ) {
+      const span & formula = formulas[ f ];
+      if ( formula.is_na() ) {
+        continue;
+      }
+      r.begin_formula( f + 1, formula.size );
+      memory_input<> in( formula.data, formula.size, "original-formula" );
+      try {
+        parse< root, nothing, heat_control >( in, r );
+      } catch ( const parse_error & ) {
+      } catch ( const budget_exceeded & ) {
+        ++abandoned;
+      }
+      r.end_formula();
+    }
+    r.report( out );
+  }
+
+} // xltoken
+
+#endif
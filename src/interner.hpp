@@ -0,0 +1,187 @@
+#ifndef XLTOKEN_INTERNER_HPP
+#define XLTOKEN_INTERNER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "arena.hpp"
+
+namespace xltoken
+{
+
+  // Excel doesn't distinguish between uppercase and lowercase in names of
+  // sheets, defined names or functions.  Only ASCII is folded, which covers
+  // the names that Excel writes in English workbooks.
+  inline char fold_case( const char c )
+  {
+    return ( c >= 'A' && c <= 'Z' ) ? c + ( 'a' - 'A' ) : c;
+  }
+
+  inline bool equal_folded( const span & a, const char * b, const std::size_t n )
+  {
+    if ( a.size != n ) {
+      return false;
+    }
+    for ( std::size_t i = 0; i < n; ++i ) {
+      if ( fold_case( a.data[ i ] ) != fold_case( b[ i ] ) ) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // FNV-1a of the case-folded characters
+  inline std::uint64_t hash_folded( const char * data, const std::size_t n )
+  {
+    std::uint64_t h = 14695981039346656037ULL;
+    for ( std::size_t i = 0; i < n; ++i ) {
+      h ^= static_cast< unsigned char >( fold_case( data[ i ] ) );
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  // Case-insensitive string interner.  Each distinct name gets an id, counting
+  // from 1, and is stored once, spelled the way it was first seen.  The
+  // strings aren't copied, so whatever they are spans of must outlive the
+  // interner, which is true of the inputs and arena of a batch.
+  //
+  // Open addressing with linear probing, so that lookups don't allocate.
+  class interner
+  {
+    public:
+      interner() : slots_( 64, 0 ) {}
+
+      int intern( const char * data, const std::size_t n )
+      {
+        std::size_t i = find( data, n );
+        if ( slots_[ i ] == 0 ) {
+          strings_.push_back( span( data, n ) );
+          slots_[ i ] = strings_.size();
+          if ( strings_.size() * 2 > slots_.size() ) {
+            grow();
+          }
+          return strings_.size();
+        }
+        return slots_[ i ];
+      }
+
+      int intern( const span & s ) { return intern( s.data, s.size ); }
+
+      // Intern a name that might not outlive the interner, copying it into an
+      // arena that will, if it's new
+      int intern( const span & s, arena & owner )
+      {
+        const int id = lookup( s.data, s.size );
+        return id != 0 ? id : intern( owner.store( s.data, s.size ) );
+      }
+
+      // The id of a name, or 0 if it hasn't been interned
+      int lookup( const char * data, const std::size_t n ) const
+      {
+        return slots_[ find( data, n ) ];
+      }
+
+      // Strings in order of id, so the string with id i is at i - 1
+      const std::vector< span > & strings() const { return strings_; }
+
+      std::size_t size() const { return strings_.size(); }
+
+    private:
+      std::vector< int > slots_;     // 0 for empty, otherwise an id
+      std::vector< span > strings_;
+
+      std::size_t find( const char * data, const std::size_t n ) const
+      {
+        const std::size_t mask = slots_.size() - 1;
+        std::size_t i = hash_folded( data, n ) & mask;
+        while ( slots_[ i ] != 0
+                && !equal_folded( strings_[ slots_[ i ] - 1 ], data, n ) ) {
+          i = ( i + 1 ) & mask;
+        }
+        return i;
+      }
+
+      void grow()
+      {
+        std::vector< int > old( slots_.size() * 2, 0 );
+        old.swap( slots_ );
+        const std::size_t mask = slots_.size() - 1;
+        for ( std::size_t id = 1; id <= strings_.size(); ++id ) {
+          const span & s = strings_[ id - 1 ];
+          std::size_t i = hash_folded( s.data, s.size ) & mask;
+          while ( slots_[ i ] != 0 ) {
+            i = ( i + 1 ) & mask;
+          }
+          slots_[ i ] = id;
+        }
+      }
+  };
+
+  // Case-sensitive string interner, e.g. for the strings of a token file.
+  // Ids count from 1, so that 0 can mean NA.  Like interner, the strings
+  // aren't copied.
+  class string_dictionary
+  {
+    public:
+      string_dictionary() : slots_( 1024, 0 ), bytes_( 0 ) {}
+
+      std::uint32_t intern( const span & s )
+      {
+        const std::size_t mask = slots_.size() - 1;
+        std::size_t i = hash( s ) & mask;
+        while ( slots_[ i ] != 0 ) {
+          const span & other = strings_[ slots_[ i ] - 1 ];
+          if ( other.size == s.size
+               && ( other.data == s.data || std::memcmp( other.data, s.data, s.size ) == 0 ) ) {
+            return slots_[ i ];
+          }
+          i = ( i + 1 ) & mask;
+        }
+        strings_.push_back( s );
+        bytes_ += s.size;
+        slots_[ i ] = strings_.size();
+        if ( strings_.size() * 2 > slots_.size() ) {
+          grow();
+        }
+        return strings_.size();
+      }
+
+      const std::vector< span > & strings() const { return strings_; }
+
+      std::uint64_t bytes() const { return bytes_; }
+
+    private:
+      std::vector< std::uint32_t > slots_;
+      std::vector< span > strings_;
+      std::uint64_t bytes_;
+
+      static std::size_t hash( const span & s )
+      {
+        std::uint64_t h = 14695981039346656037ULL;
+        for ( std::size_t i = 0; i < s.size; ++i ) {
+          h ^= static_cast< unsigned char >( s.data[ i ] );
+          h *= 1099511628211ULL;
+        }
+        return h;
+      }
+
+      void grow()
+      {
+        std::vector< std::uint32_t > old( slots_.size() * 2, 0 );
+        old.swap( slots_ );
+        const std::size_t mask = slots_.size() - 1;
+        for ( std::size_t id = 1; id <= strings_.size(); ++id ) {
+          std::size_t i = hash( strings_[ id - 1 ] ) & mask;
+          while ( slots_[ i ] != 0 ) {
+            i = ( i + 1 ) & mask;
+          }
+          slots_[ i ] = id;
+        }
+      }
+  };
+
+} // xltoken
+
+#endif
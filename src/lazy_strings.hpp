@@ -0,0 +1,236 @@
+#ifndef XLTOKEN_LAZY_STRINGS_HPP
+#define XLTOKEN_LAZY_STRINGS_HPP
+
+#include <Rcpp.h>
+#include <memory>
+#include <vector>
+#include "token_table.hpp"
+#include "wrap.hpp"
+
+// Columns of tokens and decoded values as ALTREP character vectors, whose
+// strings are only made when R asks for them.  Until then the columns are
+// the spans of the batch, so filtering or counting by the other columns
+// never puts the tokens into R's string cache.
+//
+// ALTREP strings can be used from C++ since R 3.6.  Before that, the
+// columns are made up front as usual.
+
+#include <Rversion.h>
+#if R_VERSION >= R_Version(3, 6, 0)
+#define XLTOKEN_LAZY_STRINGS
+#include <R_ext/Altrep.h>
+#endif
+
+// What the columns of a batch need after the call: the spans, the arena of
+// decoded values that aren't spans of the formulas, and the formulas, which
+// are kept by the columns in R
+struct lazy_batch
+{
+  std::vector<xltoken::span> tokens;
+  std::vector<xltoken::span> values;
+  xltoken::arena strings;
+};
+
+#ifdef XLTOKEN_LAZY_STRINGS
+
+// One column, sharing its batch with the other
+struct lazy_strings
+{
+  std::shared_ptr<lazy_batch> batch;
+  bool values;  // otherwise tokens
+
+  const std::vector<xltoken::span> & spans() const
+  {
+    return values ? batch->values : batch->tokens;
+  }
+};
+
+inline R_altrep_class_t & lazy_strings_class()
+{
+  static R_altrep_class_t altrep_class;
+  return altrep_class;
+}
+
+namespace lazy_strings_detail
+{
+
+  // data1 is an external pointer to the column, which protects the
+  // formulas.  data2 is the whole vector once it's been made, after which
+  // the column is freed.
+  inline lazy_strings * column(SEXP x)
+  {
+    return static_cast<lazy_strings *>(R_ExternalPtrAddr(R_altrep_data1(x)));
+  }
+
+  inline SEXP materialized(SEXP x)
+  {
+    return R_altrep_data2(x);
+  }
+
+  inline void finalize(SEXP pointer)
+  {
+    delete static_cast<lazy_strings *>(R_ExternalPtrAddr(pointer));
+    R_ClearExternalPtr(pointer);
+  }
+
+  inline SEXP string(const xltoken::span & value)
+  {
+    return value.is_na()
+      ? NA_STRING
+      : Rf_mkCharLenCE(value.data, value.size, CE_UTF8);
+  }
+
+  // Make every string, and let go of the spans
+  inline SEXP materialize(SEXP x)
+  {
+    SEXP out = materialized(x);
+    if (out != R_NilValue) {
+      return out;
+    }
+    const std::vector<xltoken::span> & spans = column(x)->spans();
+    R_xlen_t n = spans.size();
+    out = PROTECT(Rf_allocVector(STRSXP, n));
+    for (R_xlen_t i = 0; i < n; ++i) {
+      SET_STRING_ELT(out, i, string(spans[i]));
+    }
+    R_set_altrep_data2(x, out);
+    UNPROTECT(1);
+    SEXP pointer = R_altrep_data1(x);
+    finalize(pointer);
+    R_SetExternalPtrProtected(pointer, R_NilValue);
+    return out;
+  }
+
+  inline R_xlen_t length(SEXP x)
+  {
+    SEXP out = materialized(x);
+    return out != R_NilValue ? XLENGTH(out) : column(x)->spans().size();
+  }
+
+  inline Rboolean inspect(SEXP x, int, int, int, void (*)(SEXP, int, int, int))
+  {
+    Rprintf("xltoken lazy strings (len=%ld, materialized=%s)\n",
+            static_cast<long>(length(x)),
+            materialized(x) != R_NilValue ? "TRUE" : "FALSE");
+    return TRUE;
+  }
+
+  // A new string that only the caller protects, so callers that keep
+  // pointers into several elements must materialize the vector first (see
+  // materialize_strings() in wrap.hpp)
+  inline SEXP elt(SEXP x, R_xlen_t i)
+  {
+    SEXP out = materialized(x);
+    return out != R_NilValue ? STRING_ELT(out, i) : string(column(x)->spans()[i]);
+  }
+
+  inline void set_elt(SEXP x, R_xlen_t i, SEXP value)
+  {
+    SET_STRING_ELT(materialize(x), i, value);
+  }
+
+  inline int no_na(SEXP x)
+  {
+    return materialized(x) == R_NilValue && !column(x)->values;
+  }
+
+  // Strings can't be set through the pointer, so the read-only one will do
+  inline void * dataptr(SEXP x, Rboolean)
+  {
+    return const_cast<SEXP *>(STRING_PTR_RO(materialize(x)));
+  }
+
+  inline const void * dataptr_or_null(SEXP x)
+  {
+    SEXP out = materialized(x);
+    return out != R_NilValue ? DATAPTR_RO(out) : nullptr;
+  }
+
+  inline SEXP duplicate(SEXP x, Rboolean)
+  {
+    return Rf_duplicate(materialize(x));
+  }
+
+  // Saved as an ordinary character vector, which is what's loaded
+  inline SEXP serialized_state(SEXP x)
+  {
+    return materialize(x);
+  }
+
+  inline SEXP unserialize(SEXP, SEXP state)
+  {
+    return state;
+  }
+
+} // lazy_strings_detail
+
+// Register the class when the package is loaded
+inline void init_lazy_strings(DllInfo * dll)
+{
+  using namespace lazy_strings_detail;
+  R_altrep_class_t altrep_class =
+    R_make_altstring_class("lazy_strings", "xltoken", dll);
+  R_set_altrep_Length_method(altrep_class, length);
+  R_set_altrep_Inspect_method(altrep_class, inspect);
+  R_set_altrep_Duplicate_method(altrep_class, duplicate);
+  R_set_altrep_Serialized_state_method(altrep_class, serialized_state);
+  R_set_altrep_Unserialize_method(altrep_class, unserialize);
+  R_set_altvec_Dataptr_method(altrep_class, dataptr);
+  R_set_altvec_Dataptr_or_null_method(altrep_class, dataptr_or_null);
+  R_set_altstring_Elt_method(altrep_class, elt);
+  R_set_altstring_Set_elt_method(altrep_class, set_elt);
+  R_set_altstring_No_NA_method(altrep_class, no_na);
+  lazy_strings_class() = altrep_class;
+}
+
+// A column of the batch, whose spans are of the strings of 'formulas' or of
+// the batch's arena
+inline SEXP wrap_lazy_spans(const std::shared_ptr<lazy_batch> & batch,
+                            bool values,
+                            SEXP formulas)
+{
+  lazy_strings * strings = new lazy_strings{batch, values};
+  SEXP pointer = PROTECT(R_MakeExternalPtr(strings, R_NilValue, formulas));
+  R_RegisterCFinalizerEx(pointer, lazy_strings_detail::finalize, TRUE);
+  SEXP out = R_new_altrep(lazy_strings_class(), pointer, R_NilValue);
+  UNPROTECT(1);
+  return out;
+}
+
+#else
+
+inline void init_lazy_strings(DllInfo *) {}
+
+inline SEXP wrap_lazy_spans(const std::shared_ptr<lazy_batch> & batch,
+                            bool values,
+                            SEXP)
+{
+  return wrap_spans(values ? batch->values : batch->tokens);
+}
+
+#endif
+
+// The token and value columns of a table, which gives up its spans and
+// arena to them.  The tokens must be spans of the strings of 'formulas'.
+inline void wrap_lazy_tokens(xltoken::token_table & table,
+                             SEXP formulas,
+                             Rcpp::CharacterVector & tokens,
+                             Rcpp::CharacterVector & values)
+{
+  std::shared_ptr<lazy_batch> batch = std::make_shared<lazy_batch>();
+  batch->tokens.swap(table.tokens);
+  batch->values.swap(table.values);
+  batch->strings = std::move(table.strings);
+
+  // The columns keep their own vector of the strings, so that they can't be
+  // collected even if the caller's vector is modified
+  R_xlen_t n = XLENGTH(formulas);
+  Rcpp::CharacterVector kept(n);
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SET_STRING_ELT(kept, i, STRING_ELT(formulas, i));
+  }
+  tokens = wrap_lazy_spans(batch, false, kept);
+  values = wrap_lazy_spans(batch, true, kept);
+}
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef XLTOKEN_LEXER_HPP
+#define XLTOKEN_LEXER_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "tao/pegtl.hpp"
+
+namespace xltoken
+{
+
+  // Rules that lex a run of bytes in one pass, for the places where the
+  // grammar would otherwise try many rules per byte.
+  //
+  // * keywords< string< ... >, ... > matches the same as sor< string< ... >,
+  //   ... >, the first of the strings that the input begins with, but walks
+  //   a trie of them once along the input, rather than trying each in turn.
+  //   ExcelFunction is hundreds of names, which every identifier in a
+  //   formula was compared with.
+  // * plus_not_one< Cs... > matches the same as plus< not_one< Cs... > >,
+  //   classifying bytes with a table, and with one excluded character, eight
+  //   bytes at a time.  Strings and sheet names were a rule or three for
+  //   every byte of them.
+  //
+  // They're single rules to the parser, so they don't start any rules within
+  // them, and nothing inside them can have actions.
+
+  namespace lexer_detail
+  {
+
+    // A trie of strings, where each node is a string's prefix, with children
+    // by byte, and 'found' is the earliest of the strings that ends there, or
+    // none.  Bytes are numbered within the strings' own alphabet, 0 for any
+    // other, so a node is only as wide as that, and the trie stays in cache.
+    class trie
+    {
+      public:
+        enum : std::uint32_t { none = 0xffffffff };
+
+        struct key
+        {
+          const char * data;
+          std::size_t size;
+        };
+
+        explicit trie( const std::vector< key > & keys ) : width_( 1 )
+        {
+          std::memset( symbols_, 0, sizeof( symbols_ ) );
+          for ( std::size_t k = 0; k < keys.size(); ++k ) {
+            for ( std::size_t i = 0; i < keys[ k ].size; ++i ) {
+              unsigned char & s = symbols_[ static_cast< unsigned char >( keys[ k ].data[ i ] ) ];
+              if ( s == 0 ) {
+                s = width_++;
+              }
+            }
+          }
+          add_node();
+          for ( std::size_t k = 0; k < keys.size(); ++k ) {
+            insert( keys[ k ], k );
+          }
+        }
+
+        // The length of the earliest string that [begin, end) begins with, or
+        // 0 if there isn't one
+        std::size_t match( const char * begin, const char * end ) const
+        {
+          std::uint32_t n = 0, best = none;
+          std::size_t length = 0;
+          for ( const char * p = begin; p != end; ) {
+            n = next_[ n * width_ + symbols_[ static_cast< unsigned char >( *p++ ) ] ];
+            if ( n == 0 ) {
+              break;
+            }
+            if ( found_[ n ] < best ) {
+              best = found_[ n ];
+              length = p - begin;
+            }
+          }
+          return length;
+        }
+
+      private:
+        unsigned char symbols_[ 256 ];
+        std::uint32_t width_;
+        std::vector< std::uint32_t > next_;   // 0 for no child, since the root is no one's
+        std::vector< std::uint32_t > found_;
+
+        std::uint32_t add_node()
+        {
+          next_.resize( next_.size() + width_, 0 );
+          found_.push_back( none );
+          return found_.size() - 1;
+        }
+
+        void insert( const key & k, const std::uint32_t id )
+        {
+          std::uint32_t n = 0;
+          for ( std::size_t i = 0; i < k.size; ++i ) {
+            const std::size_t child = n * width_ + symbols_[ static_cast< unsigned char >( k.data[ i ] ) ];
+            if ( next_[ child ] == 0 ) {
+              const std::uint32_t m = add_node();
+              next_[ child ] = m;
+            }
+            n = next_[ child ];
+          }
+          if ( found_[ n ] == none ) {
+            found_[ n ] = id;
+          }
+        }
+    };
+
+    template< typename String > struct text;
+
+    template< char... Cs >
+      struct text< tao::pegtl::ascii::string< Cs... > >
+      {
+        static const char * data()
+        {
+          static const char s[] = { Cs..., 0 };
+          return s;
+        }
+        static std::size_t size() { return sizeof...( Cs ); }
+      };
+
+    template< typename... Strings >
+      std::vector< trie::key > keys()
+      {
+        const trie::key k[] = { { text< Strings >::data(), text< Strings >::size() }... };
+        return std::vector< trie::key >( k, k + sizeof...( Strings ) );
+      }
+
+    // How many bytes of [begin, end) precede the first that is one of Cs
+    template< char... Cs >
+      struct span_not
+      {
+        static std::size_t match( const char * begin, const char * end )
+        {
+          static const table excluded;
+          const char * p = begin;
+          while ( p != end && !excluded.member[ static_cast< unsigned char >( *p ) ] ) {
+            ++p;
+          }
+          return p - begin;
+        }
+
+        struct table
+        {
+          bool member[ 256 ];
+
+          table()
+          {
+            std::memset( member, 0, sizeof( member ) );
+            const char cs[] = { Cs... };
+            for ( std::size_t i = 0; i < sizeof...( Cs ); ++i ) {
+              member[ static_cast< unsigned char >( cs[ i ] ) ] = true;
+            }
+          }
+        };
+      };
+
+    // With one byte to look for, compare eight at a time: a byte of x ^ c is
+    // zero where x's is c, and (v - 0x01...) & ~v & 0x80... is nonzero when
+    // any byte of v is zero
+    template< char C >
+      struct span_not< C >
+      {
+        static std::size_t match( const char * begin, const char * end )
+        {
+          const std::uint64_t ones = 0x0101010101010101ULL;
+          const std::uint64_t c = ones * static_cast< unsigned char >( C );
+          const char * p = begin;
+          for ( ; end - p >= 8; p += 8 ) {
+            std::uint64_t x;
+            std::memcpy( &x, p, 8 );
+            x ^= c;
+            if ( ( x - ones ) & ~x & ( ones << 7 ) ) {
+              break;
+            }
+          }
+          while ( p != end && *p != C ) {
+            ++p;
+          }
+          return p - begin;
+        }
+      };
+
+  } // lexer_detail
+
+  template< typename... Strings >
+    struct keywords
+    {
+      using analyze_t = tao::pegtl::analysis::generic< tao::pegtl::analysis::rule_type::ANY >;
+
+      template< typename Input >
+        static bool match( Input & in )
+        {
+          static const lexer_detail::trie t( lexer_detail::keys< Strings... >() );
+          const std::size_t n = t.match( in.current(), in.end() );
+          if ( n == 0 ) {
+            return false;
+          }
+          in.bump( n );
+          return true;
+        }
+    };
+
+  template< char... Cs >
+    struct plus_not_one
+    {
+      using analyze_t = tao::pegtl::analysis::generic< tao::pegtl::analysis::rule_type::ANY >;
+
+      template< typename Input >
+        static bool match( Input & in )
+        {
+          const std::size_t n = lexer_detail::span_not< Cs... >::match( in.current(), in.end() );
+          if ( n == 0 ) {
+            return false;
+          }
+          in.bump( n );
+          return true;
+        }
+    };
+
+} // xltoken
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef XLTOKEN_LRU_CACHE_HPP
+#define XLTOKEN_LRU_CACHE_HPP
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "xltoken.hpp"
+#include "token_codec.hpp"
+
+namespace xltoken
+{
+
+  // A cache of the tokens of formulas in memory, for the whole process, so
+  // that formulas that are tokenized again and again in a session are only
+  // parsed once.  When the formulas and their tokens take more than its
+  // capacity in bytes, those that were used least recently are evicted.
+  //
+  // Every method locks, so threads can share it.  Tokens are decoded after
+  // unlocking, from an entry that eviction can't free while it's in use.
+  class token_lru
+  {
+    public:
+      struct stats
+      {
+        std::size_t capacity;
+        std::size_t used;
+        std::size_t entries;
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t evictions;
+      };
+
+      explicit token_lru( const std::size_t capacity )
+        : capacity_( capacity ), used_( 0 ), hits_( 0 ), misses_( 0 ), evictions_( 0 )
+      {}
+
+      // Append the tokens of a formula to a table, if it's in the cache
+      bool lookup( const span & formula, token_table & t )
+      {
+        const formula_key k = murmur3( formula.data, formula.size, formula_key{ 0, 0 } );
+        std::shared_ptr< const std::string > tokens;
+        {
+          std::lock_guard< std::mutex > lock( mutex_ );
+          if ( capacity_ == 0 ) {
+            return false;
+          }
+          map::iterator it = index_.find( k );
+          if ( it == index_.end()
+               || it->second->formula.compare( 0, std::string::npos, formula.data, formula.size ) != 0 ) {
+            ++misses_;
+            return false;
+          }
+          entries_.splice( entries_.begin(), entries_, it->second );
+          tokens = it->second->tokens;
+          ++hits_;
+        }
+        if ( !decode_tokens( tokens->data(), tokens->size(), formula, t ) ) {
+          std::lock_guard< std::mutex > lock( mutex_ );
+          --hits_;
+          ++misses_;
+          return false;
+        }
+        return true;
+      }
+
+      // Remember the tokens of a formula, its rows [begin, end) of a table
+      void add( const span & formula, const token_table & t,
+                const std::size_t begin, const std::size_t end )
+      {
+        const formula_key k = murmur3( formula.data, formula.size, formula_key{ 0, 0 } );
+        entry e;
+        e.key = k;
+        std::string tokens;
+        encode_tokens( t, begin, end, formula, tokens );
+        e.tokens = std::make_shared< const std::string >( std::move( tokens ) );
+        std::lock_guard< std::mutex > lock( mutex_ );
+        if ( capacity_ == 0 || index_.count( k ) != 0 ) {
+          return;
+        }
+        e.formula.assign( formula.data, formula.size );
+        entries_.push_front( std::move( e ) );
+        index_[ k ] = entries_.begin();
+        used_ += bytes( entries_.front() );
+        evict();
+      }
+
+      // Change the capacity, evicting whatever no longer fits
+      void resize( const std::size_t capacity )
+      {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        capacity_ = capacity;
+        evict();
+      }
+
+      // Forget every formula, and reset the counters
+      void clear()
+      {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        entries_.clear();
+        index_.clear();
+        used_ = 0;
+        hits_ = misses_ = evictions_ = 0;
+      }
+
+      stats statistics()
+      {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        stats s;
+        s.capacity = capacity_;
+        s.used = used_;
+        s.entries = entries_.size();
+        s.hits = hits_;
+        s.misses = misses_;
+        s.evictions = evictions_;
+        return s;
+      }
+
+    private:
+      struct entry
+      {
+        formula_key key;
+        std::string formula;
+        std::shared_ptr< const std::string > tokens;   // as from encode_tokens()
+      };
+
+      struct key_hash
+      {
+        std::size_t operator()( const formula_key & k ) const { return k.low; }
+      };
+
+      typedef std::unordered_map< formula_key, std::list< entry >::iterator, key_hash > map;
+
+      std::mutex mutex_;
+      std::list< entry > entries_;  // most recently used first
+      map index_;
+      std::size_t capacity_;
+      std::size_t used_;
+      std::uint64_t hits_;
+      std::uint64_t misses_;
+      std::uint64_t evictions_;
+
+      // Roughly what an entry costs, including the list and the index
+      static std::size_t bytes( const entry & e )
+      {
+        return e.formula.size() + e.tokens->size() + sizeof( entry ) + 64;
+      }
+
+      void evict()
+      {
+        while ( used_ > capacity_ && !entries_.empty() ) {
+          used_ -= bytes( entries_.back() );
+          index_.erase( entries_.back().key );
+          entries_.pop_back();
+          ++evictions_;
+        }
+      }
+  };
+
+  // The cache for the session, of 64 MB until it's resized
+  inline token_lru & session_tokens()
+  {
+    static token_lru cache( 64 << 20 );
+    return cache;
+  }
+
+  // Tokenize a formula, or take its tokens from the session's cache.  Like
+  // parse_formula(), returns whether it parsed, and only then is it cached.
+  inline bool tokenize_formula( const span & formula, token_table & t )
+  {
+    token_lru & cache = session_tokens();
+    if ( cache.lookup( formula, t ) ) {
+      fast_path().count_cached();
+      return true;
+    }
+    const std::size_t first = t.size();
+    if ( !parse_formula( formula.data, formula.size, t ) ) {
+      return false;
+    }
+    cache.add( formula, t, first, t.size() );
+    return true;
+  }
+
+} // xltoken
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef XLTOKEN_NAMES_HPP
+#define XLTOKEN_NAMES_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "xltoken.hpp"
+#include "topology.hpp"
+
+namespace xltoken
+{
+
+  // The defined names of a workbook, e.g. SalesTax or _xlnm.Print_Area, each
+  // either global or scoped to a sheet.  Every definition is tokenized once,
+  // and names resolve by a case-insensitive hash lookup.
+  //
+  // Definitions are numbered from 1 in the order they were added.  0 means
+  // "not a defined name".
+  class name_table
+  {
+    public:
+      // An empty sheet means the name is global to the workbook
+      void add( const std::string & name,
+                const std::string & sheet,
+                const std::string & formula )
+      {
+        const span n = strings_.store( name.data(), name.size() );
+        const span s = strings_.store( sheet.data(), sheet.size() );
+        const span f = strings_.store( formula.data(), formula.size() );
+        const int name_id = names_.intern( n );
+        const int sheet_id = sheet.empty() ? 0 : sheets_.intern( s );
+        name_spans_.push_back( n );
+        sheet_spans_.push_back( s );
+        formula_spans_.push_back( f );
+        // Excel doesn't allow duplicates, but if there are any, the first wins
+        by_scope_.insert( std::make_pair( key( name_id, sheet_id ), size() ) );
+      }
+
+      // Tokenize every definition, link names used in definitions to their own
+      // definitions, and find circular definitions.  Call once, after adding
+      // all the names.
+      void parse()
+      {
+        definitions_.formula = 0;
+        for ( int d = 1; d <= size(); ++d ) {
+          definitions_.formula = d;
+          const span & f = formula_spans_[ d - 1 ];
+          // A malformed definition refers to nothing
+          const std::size_t before = definitions_.size();
+          try {
+            parse_formula( f.data, f.size, definitions_ );
+          } catch ( const parse_error & ) {
+            definitions_.truncate( before );
+          }
+        }
+        resolve( definitions_, sheet_spans_, references_ );
+        find_circular();
+        find_closures();
+      }
+
+      int size() const { return name_spans_.size(); }
+
+      // The definition that a name refers to when used on a given sheet (which
+      // may be empty): a name scoped to that sheet, otherwise a global one.
+      int lookup( const span & name, const span & sheet ) const
+      {
+        const int name_id = names_.lookup( name.data, name.size );
+        if ( name_id == 0 ) {
+          return 0;
+        }
+        std::unordered_map< std::uint64_t, int >::const_iterator it;
+        if ( sheet.size != 0 ) {
+          const int sheet_id = sheets_.lookup( sheet.data, sheet.size );
+          if ( sheet_id != 0 ) {
+            it = by_scope_.find( key( name_id, sheet_id ) );
+            if ( it != by_scope_.end() ) {
+              return it->second;
+            }
+          }
+        }
+        it = by_scope_.find( key( name_id, 0 ) );
+        return it == by_scope_.end() ? 0 : it->second;
+      }
+
+      // Resolve every NAME token in a table to the definition it refers to.
+      // The sheet of formula i is sheets[i - 1], which may be empty.  A name
+      // prefixed by a sheet, e.g. Sheet1!Local, is looked up on that sheet
+      // instead.  A name prefixed by a file, e.g. [1]!Remote, is in another
+      // workbook so doesn't resolve.
+      void resolve( const token_table & table,
+                    const std::vector< span > & sheets,
+                    std::vector< int > & out ) const
+      {
+        out.assign( table.size(), 0 );
+        for ( std::size_t i = 0; i < table.size(); ++i ) {
+          if ( table.types[ i ] != "NAME" ) {
+            continue;
+          }
+          const span & token = table.tokens[ i ];
+          span sheet;
+          const int f = table.formula_ids[ i ];
+          if ( f >= 1 && f <= static_cast< int >( sheets.size() ) ) {
+            sheet = sheets[ f - 1 ];
+          }
+          if ( i > 0
+               && table.formula_ids[ i - 1 ] == f
+               && table.name_ids[ i - 1 ] != 0
+               && table.tokens[ i - 1 ].data + table.tokens[ i - 1 ].size == token.data
+               && ( table.types[ i - 1 ] == "SHEETS"
+                    || table.types[ i - 1 ] == "SHEETS-QUOTED" ) ) {
+            sheet = table.names.strings()[ table.name_ids[ i - 1 ] - 1 ];
+          } else if ( table.starts[ i ] > 0 && token.data[ -1 ] == '!' ) {
+            continue; // [1]!Remote
+          }
+          out[ i ] = lookup( token, sheet );
+        }
+      }
+
+      const span & name( const int d ) const { return name_spans_[ d - 1 ]; }
+      const span & sheet( const int d ) const { return sheet_spans_[ d - 1 ]; }
+      const span & formula( const int d ) const { return formula_spans_[ d - 1 ]; }
+
+      // Whether a definition refers to itself, directly or via other names
+      bool circular( const int d ) const { return circular_[ d - 1 ]; }
+
+      // Every definition that a definition refers to, directly or via other
+      // names, not including itself unless it's circular
+      const std::vector< int > & closure( const int d ) const
+      {
+        return closures_[ d - 1 ];
+      }
+
+      // The tokens of every definition, where formula_ids are definitions,
+      // and the definition that each NAME token in them refers to
+      const token_table & definitions() const { return definitions_; }
+      const std::vector< int > & references() const { return references_; }
+
+    private:
+      arena strings_;
+      interner names_;
+      interner sheets_;
+      std::vector< span > name_spans_;
+      std::vector< span > sheet_spans_;
+      std::vector< span > formula_spans_;
+      std::unordered_map< std::uint64_t, int > by_scope_;
+      token_table definitions_;
+      std::vector< int > references_;
+      std::vector< int > edge_offsets_;
+      std::vector< int > edges_;
+      std::vector< bool > circular_;
+      std::vector< std::vector< int > > closures_;
+
+      static std::uint64_t key( const int name_id, const int sheet_id )
+      {
+        return ( static_cast< std::uint64_t >( name_id ) << 32 )
+               | static_cast< std::uint32_t >( sheet_id );
+      }
+
+      // Edges from each definition to the ones it refers to, in compressed
+      // sparse row form, counting from 0
+      void find_circular()
+      {
+        const int n = size();
+        edge_offsets_.assign( n + 1, 0 );
+        edges_.clear();
+        for ( std::size_t i = 0; i < references_.size(); ++i ) {
+          if ( references_[ i ] != 0 ) {
+            ++edge_offsets_[ definitions_.formula_ids[ i ] ];
+          }
+        }
+        for ( int d = 0; d < n; ++d ) {
+          edge_offsets_[ d + 1 ] += edge_offsets_[ d ];
+        }
+        edges_.resize( edge_offsets_[ n ] );
+        std::vector< int > next( edge_offsets_.begin(), edge_offsets_.end() - 1 );
+        for ( std::size_t i = 0; i < references_.size(); ++i ) {
+          if ( references_[ i ] != 0 ) {
+            edges_[ next[ definitions_.formula_ids[ i ] - 1 ]++ ] = references_[ i ] - 1;
+          }
+        }
+        std::vector< int > cycles;
+        find_cycles( edge_offsets_, edges_, std::vector< bool >( n, true ), cycles );
+        circular_.assign( n, false );
+        for ( int d = 0; d < n; ++d ) {
+          circular_[ d ] = cycles[ d ] != 0;
+        }
+      }
+
+      // Depth-first from each definition.  Names are few compared with
+      // formulas, so this is cheap.
+      void find_closures()
+      {
+        const int n = size();
+        closures_.assign( n, std::vector< int >() );
+        std::vector< int > seen( n, -1 );
+        std::vector< int > stack;
+        for ( int d = 0; d < n; ++d ) {
+          stack.assign( edges_.begin() + edge_offsets_[ d ],
+                        edges_.begin() + edge_offsets_[ d + 1 ] );
+          while ( !stack.empty() ) {
+            const int v = stack.back();
+            stack.pop_back();
+            if ( seen[ v ] == d ) {
+              continue;
+            }
+            seen[ v ] = d;
+            closures_[ d ].push_back( v + 1 );
+            stack.insert( stack.end(),
+                          edges_.begin() + edge_offsets_[ v ],
+                          edges_.begin() + edge_offsets_[ v + 1 ] );
+          }
+          std::sort( closures_[ d ].begin(), closures_[ d ].end() );
+        }
+      }
+  };
+
+} // xltoken
+
+#endif
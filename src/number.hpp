@@ -0,0 +1,222 @@
+#ifndef XLTOKEN_NUMBER_HPP
+#define XLTOKEN_NUMBER_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include "powers_of_ten.hpp"
+
+namespace xltoken
+{
+
+  namespace number_detail
+  {
+
+    // Powers of ten that doubles represent exactly
+    static const double exact_powers_of_ten[] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    inline int leading_zeros( std::uint64_t x )
+    {
+#if defined( __GNUC__ ) || defined( __clang__ )
+      return __builtin_clzll( x );
+#else
+      int n = 0;
+      while ( !( x & 0x8000000000000000ULL ) ) {
+        x <<= 1;
+        ++n;
+      }
+      return n;
+#endif
+    }
+
+    // Full 64 x 64 -> 128 bit product
+    inline uint128_parts multiply( const std::uint64_t a, const std::uint64_t b )
+    {
+      uint128_parts out;
+#if defined( __SIZEOF_INT128__ )
+      const unsigned __int128 product = static_cast< unsigned __int128 >( a ) * b;
+      out.hi = static_cast< std::uint64_t >( product >> 64 );
+      out.lo = static_cast< std::uint64_t >( product );
+#else
+      const std::uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+      const std::uint64_t b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+      const std::uint64_t lo_lo = a_lo * b_lo;
+      const std::uint64_t hi_lo = a_hi * b_lo;
+      const std::uint64_t lo_hi = a_lo * b_hi;
+      const std::uint64_t hi_hi = a_hi * b_hi;
+      const std::uint64_t cross = ( lo_lo >> 32 ) + ( hi_lo & 0xFFFFFFFF ) + lo_hi;
+      out.hi = ( hi_lo >> 32 ) + ( cross >> 32 ) + hi_hi;
+      out.lo = ( cross << 32 ) | ( lo_lo & 0xFFFFFFFF );
+#endif
+      return out;
+    }
+
+    // Eisel-Lemire: the correctly-rounded double nearest to mantissa * 10^exp10,
+    // or false when the 128-bit approximation can't decide (rare), in which
+    // case the caller must fall back to something slower.
+    inline bool eisel_lemire( std::uint64_t mantissa,
+                              const int exp10,
+                              const bool negative,
+                              double & out )
+    {
+      if ( exp10 < powers_of_ten_min_exp10 || exp10 > powers_of_ten_max_exp10 ) {
+        return false;
+      }
+
+      // Normalise
+      const int clz = leading_zeros( mantissa );
+      mantissa <<= clz;
+      std::uint64_t exp2 = static_cast< std::uint64_t >(
+        ( ( 217706 * exp10 ) >> 16 ) + 64 + 1023 ) - clz;
+
+      // Multiply by the 128-bit approximation of 10^exp10
+      const uint128_parts & power = powers_of_ten[ exp10 - powers_of_ten_min_exp10 ];
+      uint128_parts x = multiply( mantissa, power.hi );
+
+      // Use the lower half of the approximation when the upper half leaves the
+      // rounding in doubt
+      if ( ( x.hi & 0x1FF ) == 0x1FF && x.lo + mantissa < mantissa ) {
+        const uint128_parts y = multiply( mantissa, power.lo );
+        uint128_parts merged = x;
+        merged.lo = x.lo + y.hi;
+        if ( merged.lo < x.lo ) {
+          ++merged.hi;
+        }
+        if ( ( merged.hi & 0x1FF ) == 0x1FF && merged.lo + 1 == 0 && y.lo + mantissa < mantissa ) {
+          return false;
+        }
+        x = merged;
+      }
+
+      // Shift to 54 bits
+      const std::uint64_t msb = x.hi >> 63;
+      std::uint64_t bits = x.hi >> ( msb + 9 );
+      exp2 -= 1 ^ msb;
+
+      // Exactly half-way between two doubles
+      if ( x.lo == 0 && ( x.hi & 0x1FF ) == 0 && ( bits & 3 ) == 1 ) {
+        return false;
+      }
+
+      // Round to 53 bits
+      bits += bits & 1;
+      bits >>= 1;
+      if ( bits >> 53 ) {
+        bits >>= 1;
+        ++exp2;
+      }
+
+      // Subnormal, infinite, or out of range
+      if ( exp2 - 1 >= 0x7FF - 1 ) {
+        return false;
+      }
+
+      std::uint64_t ieee = ( exp2 << 52 ) | ( bits & 0x000FFFFFFFFFFFFFULL );
+      if ( negative ) {
+        ieee |= 0x8000000000000000ULL;
+      }
+      std::memcpy( &out, &ieee, sizeof( out ) );
+      return true;
+    }
+
+  } // number_detail
+
+  // Convert the lexeme of a NumberToken to a double, correctly rounded.
+  //
+  // Tries, in order:
+  // * Clinger's fast path, when both the mantissa and the power of ten are
+  //   exact doubles (most numbers in formulas)
+  // * Eisel-Lemire, for up to 19 significant digits and any exponent
+  // * strtod(), for everything else
+  inline double parse_number( const char * begin, const char * end )
+  {
+    const char * p = begin;
+
+    bool negative = false;
+    if ( p != end && ( *p == '+' || *p == '-' ) ) {
+      negative = *p == '-';
+      ++p;
+    }
+
+    // Up to 19 significant digits fit in the mantissa.  Any more are only ok
+    // if they're zeros.
+    std::uint64_t mantissa = 0;
+    int significant = 0;
+    int exp10 = 0;
+    bool truncated = false;
+    bool fraction = false;
+    for ( ; p != end; ++p ) {
+      if ( *p == '.' ) {
+        fraction = true;
+        continue;
+      }
+      if ( *p < '0' || *p > '9' ) {
+        break;
+      }
+      const int digit = *p - '0';
+      if ( significant < 19 ) {
+        if ( mantissa != 0 || digit != 0 ) {
+          mantissa = mantissa * 10 + digit;
+          ++significant;
+        }
+        if ( fraction ) {
+          --exp10;
+        }
+      } else {
+        truncated = truncated || digit != 0;
+        if ( !fraction ) {
+          ++exp10;
+        }
+      }
+    }
+
+    if ( p != end && ( *p == 'e' || *p == 'E' ) ) {
+      ++p;
+      bool negative_exponent = false;
+      if ( p != end && ( *p == '+' || *p == '-' ) ) {
+        negative_exponent = *p == '-';
+        ++p;
+      }
+      int exponent = 0;
+      for ( ; p != end && *p >= '0' && *p <= '9'; ++p ) {
+        if ( exponent < 100000 ) { // way beyond the range of doubles
+          exponent = exponent * 10 + ( *p - '0' );
+        }
+      }
+      exp10 += negative_exponent ? -exponent : exponent;
+    }
+
+    if ( mantissa == 0 && !truncated ) {
+      return negative ? -0.0 : 0.0;
+    }
+
+    if ( !truncated ) {
+      if ( mantissa <= ( std::uint64_t( 1 ) << 53 ) && exp10 >= -22 && exp10 <= 22 ) {
+        double out = static_cast< double >( mantissa );
+        if ( exp10 < 0 ) {
+          out /= number_detail::exact_powers_of_ten[ -exp10 ];
+        } else {
+          out *= number_detail::exact_powers_of_ten[ exp10 ];
+        }
+        return negative ? -out : out;
+      }
+      double out;
+      if ( number_detail::eisel_lemire( mantissa, exp10, negative, out ) ) {
+        return out;
+      }
+    }
+
+    // strtod() needs a terminated string.  R always runs with the C numeric
+    // locale, so the decimal point is a dot.
+    const std::string copy( begin, end );
+    return std::strtod( copy.c_str(), nullptr );
+  }
+
+} // xltoken
+
+#endif
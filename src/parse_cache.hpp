@@ -0,0 +1,376 @@
+#ifndef XLTOKEN_PARSE_CACHE_HPP
+#define XLTOKEN_PARSE_CACHE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "xltoken.hpp"
+#include "token_file.hpp"
+#include "token_codec.hpp"
+
+namespace xltoken
+{
+
+  // A cache of the tokens of formulas on disk, so that formulas that were
+  // tokenized by an earlier run needn't be parsed again.
+  //
+  // The cache is a directory of two files.  tokens.log is an append-only log
+  // of the tokens of each formula, keyed by a 128-bit hash of the formula and
+  // the grammar.  tokens.idx is a hash table from keys to where they are in
+  // the log, with open addressing and linear probing, which is mapped into
+  // memory.  Both begin with a fingerprint of the grammar, and are ignored if
+  // it has changed.  Each record also holds its formula, which a lookup
+  // compares, so formulas whose hashes collide never share tokens.
+  //
+  // Any number of processes can read the cache while one writes to it.  The
+  // writer only appends to the log, and writes each new index to another file
+  // that it then renames over the old one, so readers see either the old
+  // index or the new one, and whatever log they've mapped never changes
+  // under them.  A record is also only used if its key matches, so a corrupt
+  // index can't make a reader return the wrong tokens.
+
+  // Changes whenever the actions do, i.e. what tokens the grammar emits
+  const std::uint32_t token_actions_version = 1;
+
+  namespace parse_cache_detail
+  {
+
+    // The grammar's rules, what each is and what it's made of, as PEGTL's
+    // analysis finds them, so that any change to the grammar changes it
+    inline formula_key fingerprint_grammar()
+    {
+      analysis::grammar_info g;
+      root::analyze_t::template insert< root >( g );
+      std::string rules;
+      for ( analysis::grammar_info::map_t::const_iterator it = g.map.begin();
+            it != g.map.end(); ++it ) {
+        rules += it->first;
+        rules += static_cast< char >( it->second.type );
+        for ( std::size_t r = 0; r < it->second.rules.size(); ++r ) {
+          rules += ' ';
+          rules += it->second.rules[ r ];
+        }
+        rules += '\n';
+      }
+      return murmur3( rules.data(), rules.size(), formula_key{ token_actions_version, 0 } );
+    }
+
+    inline const formula_key & grammar_fingerprint()
+    {
+      static const formula_key fingerprint = fingerprint_grammar();
+      return fingerprint;
+    }
+
+    const char log_magic[ 8 ] = { 'X', 'L', 'T', 'C', 'L', 'O', 'G', '2' };
+    const char index_magic[ 8 ] = { 'X', 'L', 'T', 'C', 'I', 'D', 'X', '2' };
+
+    struct header
+    {
+      char magic[ 8 ];
+      std::uint32_t byte_order;
+      std::uint32_t reserved;
+      formula_key grammar;
+      std::uint64_t capacity;  // of the index
+      std::uint64_t count;     // of the index
+      std::uint64_t log_size;  // that the index covers
+      std::uint64_t padding;
+    };
+
+    struct slot
+    {
+      formula_key k;
+      std::uint64_t offset; // of the record in the log, 0 for none
+    };
+
+    // Each record of the log is its key, the size of its formula and of its
+    // tokens, then its formula and its tokens, padded to 8 bytes
+    struct record
+    {
+      formula_key k;
+      std::uint32_t formula_size;
+      std::uint32_t size;
+    };
+
+    inline bool valid( const mapped_file & file, const char * magic )
+    {
+      header h;
+      if ( file.size() < sizeof( h ) ) {
+        return false;
+      }
+      std::memcpy( &h, file.data(), sizeof( h ) );
+      return std::memcmp( h.magic, magic, sizeof( h.magic ) ) == 0
+             && h.byte_order == token_file_byte_order
+             && h.grammar == grammar_fingerprint();
+    }
+
+    inline header make_header( const char * magic )
+    {
+      header h;
+      std::memset( &h, 0, sizeof( h ) );
+      std::memcpy( h.magic, magic, sizeof( h.magic ) );
+      h.byte_order = token_file_byte_order;
+      h.grammar = grammar_fingerprint();
+      return h;
+    }
+
+    // Replace a file with another, atomically for readers
+    inline void replace( const std::string & from, const std::string & to )
+    {
+#ifdef _WIN32
+      const bool replaced = MoveFileExA( from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+      const bool replaced = std::rename( from.c_str(), to.c_str() ) == 0;
+#endif
+      if ( !replaced ) {
+        std::remove( from.c_str() );
+        throw std::runtime_error( "Can't replace " + to );
+      }
+    }
+
+  } // parse_cache_detail
+
+  class parse_cache
+  {
+    public:
+      // Open the cache in a directory, which must exist.  Files that are
+      // missing, or of another grammar, are an empty cache.
+      explicit parse_cache( const std::string & directory )
+        : log_path_( directory + "/tokens.log" ),
+          index_path_( directory + "/tokens.idx" ),
+          capacity_( 0 ), count_( 0 ), log_size_( 0 )
+      {
+        open();
+      }
+
+      // Append the tokens of a formula to a table, if it's in the cache
+      bool lookup( const span & formula, token_table & t ) const
+      {
+        using namespace parse_cache_detail;
+        return capacity_ != 0 && find( hash( formula ), formula, t );
+      }
+
+      // Remember the tokens of a formula, its rows [begin, end) of a table,
+      // to be written by commit()
+      void add( const span & formula, const token_table & t,
+                const std::size_t begin, const std::size_t end )
+      {
+        using namespace parse_cache_detail;
+        const formula_key k = hash( formula );
+        if ( !added_.insert( std::make_pair( k.low, k.high ) ).second ) {
+          return;
+        }
+        std::string tokens;
+        encode_tokens( t, begin, end, formula, tokens );
+        record r;
+        r.k = k;
+        r.formula_size = formula.size;
+        r.size = tokens.size();
+        pending_.append( reinterpret_cast< const char * >( &r ), sizeof( r ) );
+        pending_.append( formula.data, formula.size );
+        pending_ += tokens;
+        pending_.resize( ( pending_.size() + 7 ) / 8 * 8, '\0' );
+        pending_keys_.push_back( k );
+      }
+
+      // Write what's been added, then a new index, and open the cache again,
+      // so that it has what was added.  Throws std::runtime_error if the files
+      // can't be written.
+      void commit()
+      {
+        using namespace parse_cache_detail;
+        if ( pending_keys_.empty() ) {
+          return;
+        }
+
+        // The new index has the old entries and the new ones, and is at most
+        // half full
+        const bool fresh = capacity_ == 0;
+        std::uint64_t capacity = 1024;
+        const std::uint64_t count = ( fresh ? 0 : count_ ) + pending_keys_.size();
+        while ( capacity < 2 * count ) {
+          capacity *= 2;
+        }
+        std::vector< slot > slots( capacity );
+        std::memset( slots.data(), 0, capacity * sizeof( slot ) );
+        if ( !fresh ) {
+          for ( std::uint64_t s = 0; s < capacity_; ++s ) {
+            const slot & old = old_slots()[ s ];
+            if ( old.offset != 0 ) {
+              insert( slots, old );
+            }
+          }
+        }
+
+        // Windows won't write to or replace files that are mapped, so let go
+        // of them until they've been written
+        capacity_ = count_ = log_size_ = 0;
+        index_.reset();
+        log_.reset();
+        try {
+          write( fresh, slots, count );
+        } catch ( const std::runtime_error & ) {
+          open();
+          throw;
+        }
+        pending_.clear();
+        pending_keys_.clear();
+        open();
+      }
+
+    private:
+      std::string log_path_;
+      std::string index_path_;
+      std::unique_ptr< mapped_file > log_;
+      std::unique_ptr< mapped_file > index_;
+      std::uint64_t capacity_;  // 0 if there's no usable cache
+      std::uint64_t count_;
+      std::uint64_t log_size_;
+      std::string pending_;     // records to append to the log
+      std::vector< formula_key > pending_keys_;
+
+      struct key_hash
+      {
+        std::size_t operator()( const std::pair< std::uint64_t, std::uint64_t > & k ) const
+        {
+          return k.first;
+        }
+      };
+      std::unordered_set< std::pair< std::uint64_t, std::uint64_t >, key_hash > added_;
+
+      // Map the files, leaving the cache empty if they're missing, of another
+      // grammar, or don't agree
+      void open()
+      {
+        using namespace parse_cache_detail;
+        capacity_ = count_ = log_size_ = 0;
+        index_.reset();
+        log_.reset();
+        try {
+          log_.reset( new mapped_file( log_path_ ) );
+          index_.reset( new mapped_file( index_path_ ) );
+        } catch ( const std::runtime_error & ) {
+        }
+        if ( !log_ || !index_ || !valid( *log_, log_magic ) || !valid( *index_, index_magic ) ) {
+          return;
+        }
+        header h;
+        std::memcpy( &h, index_->data(), sizeof( h ) );
+        if ( sizeof( h ) + h.capacity * sizeof( slot ) == index_->size()
+             && h.log_size <= log_->size()
+             && ( h.capacity & ( h.capacity - 1 ) ) == 0 ) {
+          capacity_ = h.capacity;
+          count_ = h.count;
+          log_size_ = log_->size();
+        }
+      }
+
+      // Append the pending records to the log, starting a new one if there
+      // isn't one of this grammar, and write an index of them and the old
+      // slots
+      void write( const bool fresh, std::vector< parse_cache_detail::slot > & slots,
+                  const std::uint64_t count )
+      {
+        using namespace parse_cache_detail;
+        if ( fresh ) {
+          const header h = make_header( log_magic );
+          write_file( log_path_ + ".tmp", &h, sizeof( h ), "wb" );
+          replace( log_path_ + ".tmp", log_path_ );
+        }
+        const std::uint64_t at = write_file( log_path_, pending_.data(), pending_.size(), "ab" );
+        for ( std::size_t p = 0, offset = 0; p < pending_keys_.size(); ++p ) {
+          record r;
+          std::memcpy( &r, pending_.data() + offset, sizeof( r ) );
+          insert( slots, slot{ pending_keys_[ p ], at + offset } );
+          offset += ( sizeof( r ) + r.formula_size + r.size + 7 ) / 8 * 8;
+        }
+
+        header h = make_header( index_magic );
+        h.capacity = slots.size();
+        h.count = count;
+        h.log_size = at + pending_.size();
+        std::string index( reinterpret_cast< const char * >( &h ), sizeof( h ) );
+        index.append( reinterpret_cast< const char * >( slots.data() ), slots.size() * sizeof( slot ) );
+        write_file( index_path_ + ".tmp", index.data(), index.size(), "wb" );
+        replace( index_path_ + ".tmp", index_path_ );
+      }
+
+      static formula_key hash( const span & formula )
+      {
+        return murmur3( formula.data, formula.size, parse_cache_detail::grammar_fingerprint() );
+      }
+
+      const parse_cache_detail::slot * old_slots() const
+      {
+        return reinterpret_cast< const parse_cache_detail::slot * >(
+          index_->data() + sizeof( parse_cache_detail::header ) );
+      }
+
+      bool find( const formula_key & k, const span & formula, token_table & t ) const
+      {
+        using namespace parse_cache_detail;
+        const std::uint64_t mask = capacity_ - 1;
+        for ( std::uint64_t i = k.low & mask, probes = 0; probes < capacity_;
+              i = ( i + 1 ) & mask, ++probes ) {
+          const slot & s = old_slots()[ i ];
+          if ( s.offset == 0 ) {
+            return false;
+          }
+          if ( !( s.k == k ) ) {
+            continue;
+          }
+          // Trust the log, not the index
+          record r;
+          if ( s.offset < sizeof( header ) || s.offset + sizeof( r ) > log_size_ ) {
+            return false;
+          }
+          std::memcpy( &r, log_->data() + s.offset, sizeof( r ) );
+          const char * stored = log_->data() + s.offset + sizeof( r );
+          if ( !( r.k == k ) || r.formula_size != formula.size
+               || s.offset + sizeof( r ) + r.formula_size + r.size > log_size_
+               || std::memcmp( stored, formula.data, formula.size ) != 0 ) {
+            return false;
+          }
+          return decode_tokens( stored + r.formula_size, r.size, formula, t );
+        }
+        return false;
+      }
+
+      static void insert( std::vector< parse_cache_detail::slot > & slots,
+                          const parse_cache_detail::slot & s )
+      {
+        const std::uint64_t mask = slots.size() - 1;
+        std::uint64_t i = s.k.low & mask;
+        while ( slots[ i ].offset != 0 ) {
+          i = ( i + 1 ) & mask;
+        }
+        slots[ i ] = s;
+      }
+
+      // Write or append to a file, returning where the data begins
+      static std::uint64_t write_file( const std::string & path, const void * data,
+                                       const std::size_t size, const char * mode )
+      {
+        std::FILE * file = std::fopen( path.c_str(), mode );
+        if ( file == nullptr ) {
+          throw std::runtime_error( "Can't write to " + path );
+        }
+        const bool ended = std::fseek( file, 0, SEEK_END ) == 0;
+        const long at = std::ftell( file );
+        const bool written = ended && at >= 0 && std::fwrite( data, 1, size, file ) == size;
+        if ( std::fclose( file ) != 0 || !written ) {
+          throw std::runtime_error( "Can't write to " + path );
+        }
+        return at;
+      }
+  };
+
+} // xltoken
+
+#endif
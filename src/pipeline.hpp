@@ -0,0 +1,268 @@
+#ifndef XLTOKEN_PIPELINE_HPP
+#define XLTOKEN_PIPELINE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <thread>
+#include <vector>
+#include "xltoken.hpp"
+
+namespace xltoken
+{
+
+  // Tokenizes formulas from memory, e.g. a mapped file, one to a line, and
+  // writes their tokens in order, in three stages that run at once:
+  // * a reader, which splits the formulas into batches of lines,
+  // * parsers on 'threads' threads, which tokenize a batch each, and
+  // * a writer, on the calling thread, which writes the batches in order.
+  //
+  // The stages pass batches round a ring of slots, which bounds the memory
+  // in flight.  Each slot has an atomic stamp of where its batch is up to,
+  // so no stage takes a lock: the reader fills a slot once the writer has
+  // finished with it, a parser takes the next batch to be read, and the
+  // writer takes the next batch in order once it's been parsed.  A stage
+  // whose next slot isn't ready spins, then yields, then sleeps.
+
+  // How long it took, and how much of its time each stage spent working
+  // rather than waiting for the others.  The slowest stage is busiest.
+  struct pipeline_stats
+  {
+    std::size_t formulas;
+    std::size_t tokens;
+    double seconds;
+    double reader;
+    double parsers;  // the mean of the threads
+    double writer;
+  };
+
+  namespace pipeline_detail
+  {
+
+    typedef std::chrono::steady_clock clock;
+
+    // Batch s is in slot s % slots, for the u = s / slots time.  Its stamp
+    // is 3u while the slot is free, 3u + 1 once it's been read and 3u + 2
+    // once it's been parsed, and the writer makes it 3(u + 1).
+    struct slot
+    {
+      std::atomic< std::size_t > stamp;
+      std::size_t first;            // formulas before this batch
+      std::vector< span > formulas;
+      token_table table;
+
+      slot() : stamp( 0 ), first( 0 ) {}
+    };
+
+    // What one stage or thread shares with the others
+    struct shared
+    {
+      std::vector< slot > slots;
+      std::atomic< std::size_t > batches;  // once they've all been read
+      std::atomic< std::size_t > claimed;  // by the parsers
+      std::atomic< bool > failed;
+      std::exception_ptr error;
+      std::atomic< bool > error_taken;
+
+      explicit shared( const std::size_t n )
+        : slots( n ), batches( std::numeric_limits< std::size_t >::max() ),
+          claimed( 0 ), failed( false ), error_taken( false )
+      {}
+
+      // Stop every stage, keeping the first error
+      void fail( const std::exception_ptr & e )
+      {
+        if ( !error_taken.exchange( true ) ) {
+          error = e;
+        }
+        failed = true;
+      }
+    };
+
+    // Time spent waiting by one stage
+    class stage
+    {
+      public:
+        stage() : begin_( clock::now() ), waited_( 0 ) {}
+
+        // Wait until 'ready', or until the pipeline fails or 'done', which
+        // return false
+        template< typename Ready, typename Done >
+          bool wait( const shared & s, Ready ready, Done done )
+          {
+            if ( ready() ) {
+              return true;
+            }
+            const clock::time_point from = clock::now();
+            for ( unsigned spins = 0; !ready(); ++spins ) {
+              if ( s.failed || done() ) {
+                waited_ += clock::now() - from;
+                return false;
+              }
+              if ( spins < 64 ) {
+                continue;
+              } else if ( spins < 256 ) {
+                std::this_thread::yield();
+              } else {
+                std::this_thread::sleep_for( std::chrono::microseconds( 50 ) );
+              }
+            }
+            waited_ += clock::now() - from;
+            return true;
+          }
+
+        // The share of its time that it has worked
+        double busy() const
+        {
+          const double total = std::chrono::duration< double >( clock::now() - begin_ ).count();
+          const double waited = std::chrono::duration< double >( waited_ ).count();
+          return total > 0 ? std::max( 0.0, 1 - waited / total ) : 0;
+        }
+
+      private:
+        clock::time_point begin_;
+        clock::duration waited_;
+    };
+
+    // Split [begin, end) into batches of 'batch' lines
+    inline void read_batches( shared & s, const char * begin, const char * end,
+                              const std::size_t batch, double & busy )
+    {
+      stage me;
+      const std::size_t n = s.slots.size();
+      std::size_t b = 0, first = 0;
+      try {
+        for ( const char * p = begin; p < end; ++b ) {
+          slot & into = s.slots[ b % n ];
+          const std::size_t free = 3 * ( b / n );
+          if ( !me.wait( s, [ & ] { return into.stamp.load( std::memory_order_acquire ) == free; },
+                         [] { return false; } ) ) {
+            break;
+          }
+          into.first = first;
+          into.formulas.clear();
+          while ( p < end && into.formulas.size() < batch ) {
+            const char * eol = static_cast< const char * >( std::memchr( p, '\n', end - p ) );
+            const char * next = eol == nullptr ? end : eol + 1;
+            if ( eol == nullptr ) {
+              eol = end;
+            }
+            if ( eol > p && eol[ -1 ] == '\r' ) {
+              --eol;
+            }
+            into.formulas.push_back( span( p, eol - p ) );
+            p = next;
+          }
+          first += into.formulas.size();
+          into.stamp.store( free + 1, std::memory_order_release );
+        }
+      } catch ( ... ) {
+        s.fail( std::current_exception() );
+      }
+      s.batches = b;
+      busy = me.busy();
+    }
+
+    // Tokenize batches until they've all been claimed
+    inline void parse_batches( shared & s, double & busy )
+    {
+      stage me;
+      const std::size_t n = s.slots.size();
+      try {
+        for ( std::size_t b = s.claimed.fetch_add( 1 ); ; b = s.claimed.fetch_add( 1 ) ) {
+          slot & from = s.slots[ b % n ];
+          const std::size_t read = 3 * ( b / n ) + 1;
+          if ( !me.wait( s, [ & ] { return from.stamp.load( std::memory_order_acquire ) == read; },
+                         [ & ] { return b >= s.batches; } ) ) {
+            break;
+          }
+          from.table = token_table();
+          for ( std::size_t f = 0; f < from.formulas.size(); ++f ) {
+            const span & formula = from.formulas[ f ];
+            from.table.formula = from.first + f + 1;
+            try {
+              if ( formula.size != 0 ) {
+                parse_formula( formula.data, formula.size, from.table );
+              }
+            } catch ( const parse_error & ) {
+            }
+          }
+          from.stamp.store( read + 1, std::memory_order_release );
+        }
+      } catch ( ... ) {
+        s.fail( std::current_exception() );
+      }
+      busy = me.busy();
+    }
+
+  } // pipeline_detail
+
+  // Tokenize the formulas in [begin, end) and write each batch's table with
+  // writer.write( const token_table & ), in order.  Rethrows the first
+  // exception of any stage.
+  template< typename Writer >
+    pipeline_stats tokenize_pipeline( const char * begin,
+                                      const char * end,
+                                      Writer & writer,
+                                      const unsigned threads,
+                                      const std::size_t batch = 4096 )
+    {
+      using namespace pipeline_detail;
+      const clock::time_point start = clock::now();
+      const unsigned parsers = std::max( threads, 1u );
+      shared s( 2 * parsers + 2 );
+      const std::size_t n = s.slots.size();
+
+      double reader_busy = 0;
+      std::vector< double > parser_busy( parsers, 0 );
+      std::vector< std::thread > workers;
+      workers.push_back( std::thread( read_batches, std::ref( s ), begin, end,
+                                      std::max< std::size_t >( batch, 1 ),
+                                      std::ref( reader_busy ) ) );
+      for ( unsigned t = 0; t < parsers; ++t ) {
+        workers.push_back( std::thread( parse_batches, std::ref( s ), std::ref( parser_busy[ t ] ) ) );
+      }
+
+      pipeline_stats out;
+      out.formulas = 0;
+      out.tokens = 0;
+      stage me;
+      try {
+        for ( std::size_t b = 0; ; ++b ) {
+          slot & from = s.slots[ b % n ];
+          const std::size_t parsed = 3 * ( b / n ) + 2;
+          if ( !me.wait( s, [ & ] { return from.stamp.load( std::memory_order_acquire ) == parsed; },
+                         [ & ] { return b >= s.batches; } ) ) {
+            break;
+          }
+          writer.write( from.table );
+          out.formulas += from.formulas.size();
+          out.tokens += from.table.size();
+          from.stamp.store( parsed + 1, std::memory_order_release );
+        }
+      } catch ( ... ) {
+        s.fail( std::current_exception() );
+      }
+      out.writer = me.busy();
+      for ( std::size_t t = 0; t < workers.size(); ++t ) {
+        workers[ t ].join();
+      }
+      if ( s.error ) {
+        std::rethrow_exception( s.error );
+      }
+
+      out.seconds = std::chrono::duration< double >( clock::now() - start ).count();
+      out.reader = reader_busy;
+      out.parsers = 0;
+      for ( unsigned t = 0; t < parsers; ++t ) {
+        out.parsers += parser_busy[ t ] / parsers;
+      }
+      return out;
+    }
+
+} // xltoken
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef XLTOKEN_REFERENCES_HPP
+#define XLTOKEN_REFERENCES_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "arena.hpp"
+
+namespace xltoken
+{
+
+  // The size of a worksheet since Excel 2007
+  const int max_rows = 1048576;
+  const int max_cols = 16384;
+
+  // A row or column of a reference, e.g. the $A of $A$1, counting from 1
+  struct coordinate
+  {
+    int index;
+    bool absolute;
+  };
+
+  // Parse the column letters at the start of s, e.g. "$AB" of "$AB12".
+  // Returns the number of characters consumed, or 0 if there weren't any.
+  inline std::size_t parse_column( const char * s, const std::size_t n, coordinate & out )
+  {
+    std::size_t i = 0;
+    out.absolute = n > 0 && s[ 0 ] == '$';
+    i += out.absolute;
+    out.index = 0;
+    const std::size_t first = i;
+    for ( ; i < n && s[ i ] >= 'A' && s[ i ] <= 'Z'; ++i ) {
+      if ( out.index <= max_cols ) { // don't overflow on nonsense
+        out.index = out.index * 26 + ( s[ i ] - 'A' + 1 );
+      }
+    }
+    return i == first ? 0 : i;
+  }
+
+  // Parse the row digits at the start of s, e.g. "$12" of "$12:$13"
+  inline std::size_t parse_row( const char * s, const std::size_t n, coordinate & out )
+  {
+    std::size_t i = 0;
+    out.absolute = n > 0 && s[ 0 ] == '$';
+    i += out.absolute;
+    out.index = 0;
+    const std::size_t first = i;
+    for ( ; i < n && s[ i ] >= '0' && s[ i ] <= '9'; ++i ) {
+      if ( out.index <= max_rows ) { // don't overflow on nonsense
+        out.index = out.index * 10 + ( s[ i ] - '0' );
+      }
+    }
+    return i == first ? 0 : i;
+  }
+
+  // A cell reference, e.g. the lexeme of a CELL token
+  struct cell_reference
+  {
+    coordinate row;
+    coordinate col;
+  };
+
+  inline bool parse_cell( const span & s, cell_reference & out )
+  {
+    const std::size_t c = parse_column( s.data, s.size, out.col );
+    return c != 0 && parse_row( s.data + c, s.size - c, out.row ) == s.size - c;
+  }
+
+  // The two ends of a VERTICAL-RANGE (A:C) or HORIZONTAL-RANGE (1:3) token
+  inline bool parse_columns( const span & s, coordinate & first, coordinate & last )
+  {
+    const std::size_t c = parse_column( s.data, s.size, first );
+    return c != 0 && c < s.size && s.data[ c ] == ':'
+           && parse_column( s.data + c + 1, s.size - c - 1, last ) == s.size - c - 1;
+  }
+
+  inline bool parse_rows( const span & s, coordinate & first, coordinate & last )
+  {
+    const std::size_t r = parse_row( s.data, s.size, first );
+    return r != 0 && r < s.size && s.data[ r ] == ':'
+           && parse_row( s.data + r + 1, s.size - r - 1, last ) == s.size - r - 1;
+  }
+
+  // A rectangle of cells on a sheet, identified by an id from an interner.
+  // Whole columns and rows extend to the edges of the sheet.
+  struct area
+  {
+    int sheet;
+    int first_row;
+    int first_col;
+    int last_row;
+    int last_col;
+
+    bool is_cell() const
+    {
+      return first_row == last_row && first_col == last_col;
+    }
+
+    bool contains( const int row, const int col ) const
+    {
+      return row >= first_row && row <= last_row
+             && col >= first_col && col <= last_col;
+    }
+
+    bool operator==( const area & other ) const
+    {
+      return sheet == other.sheet
+             && first_row == other.first_row && first_col == other.first_col
+             && last_row == other.last_row && last_col == other.last_col;
+    }
+
+    bool operator<( const area & other ) const
+    {
+      if ( sheet != other.sheet ) return sheet < other.sheet;
+      if ( first_col != other.first_col ) return first_col < other.first_col;
+      if ( first_row != other.first_row ) return first_row < other.first_row;
+      if ( last_col != other.last_col ) return last_col < other.last_col;
+      return last_row < other.last_row;
+    }
+  };
+
+  // Whether a cell or an area is within a worksheet.  References beyond it,
+  // e.g. ZZZZ1 or A0, parse but refer to nothing.
+  inline bool in_sheet( const int row, const int col )
+  {
+    return row >= 1 && row <= max_rows && col >= 1 && col <= max_cols;
+  }
+
+  inline bool in_sheet( const area & a )
+  {
+    return in_sheet( a.first_row, a.first_col ) && in_sheet( a.last_row, a.last_col );
+  }
+
+  struct area_hash
+  {
+    std::size_t operator()( const area & a ) const
+    {
+      std::uint64_t h = a.sheet;
+      h = h * 1000003 + a.first_row;
+      h = h * 1000003 + a.first_col;
+      h = h * 1000003 + a.last_row;
+      h = h * 1000003 + a.last_col;
+      return h ^ ( h >> 29 );
+    }
+  };
+
+  // Sort key of a cell, ordered by sheet, then column, then row, so that the
+  // cells of a column of an area are contiguous.  The cell must be in_sheet(),
+  // or its row and column would spill into the fields above them.
+  inline std::uint64_t cell_key( const int sheet, const int row, const int col )
+  {
+    return ( static_cast< std::uint64_t >( sheet ) << 36 )
+           | ( static_cast< std::uint64_t >( col ) << 21 )
+           | static_cast< std::uint64_t >( row );
+  }
+
+} // xltoken
+
+#endif
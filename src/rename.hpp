@@ -0,0 +1,163 @@
+#ifndef XLTOKEN_RENAME_HPP
+#define XLTOKEN_RENAME_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+#include "xltoken.hpp"
+#include "rewrite.hpp"
+
+namespace xltoken
+{
+
+  // Renaming a sheet, and rewriting the prefixes of references to it, e.g.
+  // Sheet1!A1 to 'Q1 Sales'!A1.
+
+  struct UnquotedSheetName : seq< normalSheetName, eof > {};
+  struct CellLikeSheetName : seq< CellToken, eof > {};
+
+  // Whether a sheet name must be quoted in a reference: if it has characters
+  // that normalSheetName doesn't allow, starts with a digit, or could be taken
+  // for a cell reference in either style, e.g. A1, r1c1 or C, or for a
+  // boolean, which the grammar takes before a sheet name
+  inline bool needs_quotes( const span & name )
+  {
+    if ( name.size == 0 || std::isdigit( static_cast< unsigned char >( name.data[ 0 ] ) ) ) {
+      return true;
+    }
+    memory_input<> in( name.data, name.size, "sheet-name" );
+    if ( !parse< UnquotedSheetName >( in ) ) {
+      return true;
+    }
+    std::string upper( name.data, name.size );
+    for ( std::size_t i = 0; i < upper.size(); ++i ) {
+      upper[ i ] = std::toupper( static_cast< unsigned char >( upper[ i ] ) );
+    }
+    if ( upper == "TRUE" || upper == "FALSE" ) {
+      return true;
+    }
+    memory_input<> cell( upper, "sheet-name" );
+    if ( parse< CellLikeSheetName >( cell ) ) {
+      return true;
+    }
+    // R, R1, R1C, R1C1, C, C1
+    std::size_t i = 0;
+    if ( upper[ i ] == 'R' ) {
+      for ( ++i; i < upper.size() && std::isdigit( static_cast< unsigned char >( upper[ i ] ) ); ++i ) {}
+    }
+    if ( i < upper.size() && upper[ i ] == 'C' ) {
+      for ( ++i; i < upper.size() && std::isdigit( static_cast< unsigned char >( upper[ i ] ) ); ++i ) {}
+    }
+    return i == upper.size();
+  }
+
+  // A sheet name, or the ends of a 3D range of sheets, as a prefix, quoted
+  // and with ' escaped as '' if need be
+  inline std::string write_prefix( const std::vector< span > & sheets )
+  {
+    bool quote = false;
+    for ( std::size_t s = 0; s < sheets.size(); ++s ) {
+      quote = quote || needs_quotes( sheets[ s ] );
+    }
+    std::string out;
+    if ( quote ) {
+      out += '\'';
+    }
+    for ( std::size_t s = 0; s < sheets.size(); ++s ) {
+      if ( s > 0 ) {
+        out += ':';
+      }
+      for ( std::size_t i = 0; i < sheets[ s ].size; ++i ) {
+        if ( sheets[ s ].data[ i ] == '\'' ) {
+          out += '\'';
+        }
+        out += sheets[ s ].data[ i ];
+      }
+    }
+    if ( quote ) {
+      out += '\'';
+    }
+    out += '!';
+    return out;
+  }
+
+  // Rewrites the sheet prefixes of many formulas with rewrite_formulas().
+  //
+  // Sheets are interned per batch, so each distinct prefix in a batch is
+  // compared with the old name once, and only the SHEETS and SHEETS-QUOTED
+  // tokens whose interned id matches are rewritten.  Either end of a 3D
+  // prefix, e.g. Sheet1:Sheet3!, can match.  Formulas that don't mention the
+  // old name at all aren't tokenized.  References to other workbooks are
+  // left alone.
+  class sheet_renamer
+  {
+    public:
+      sheet_renamer( const span & from, const span & to ) : from_( from ), to_( to ) {}
+
+      bool wanted( const std::size_t, const span & formula ) const
+      {
+        return mentions( formula, from_ );
+      }
+
+      // The new prefix for each interned name that is a matching sheet,
+      // otherwise empty
+      void batch( const token_table & t )
+      {
+        const std::vector< span > & names = t.names.strings();
+        prefixes_.assign( names.size(), std::string() );
+        std::vector< span > ends;
+        for ( std::size_t id = 0; id < names.size(); ++id ) {
+          const span & name = names[ id ];
+          const char * colon = std::find( name.data, name.data + name.size, ':' );
+          ends.clear();
+          ends.push_back( span( name.data, colon - name.data ) );
+          if ( colon != name.data + name.size ) {
+            ends.push_back( span( colon + 1, name.data + name.size - colon - 1 ) );
+          }
+          bool renamed = false;
+          for ( std::size_t e = 0; e < ends.size(); ++e ) {
+            if ( equal_folded( ends[ e ], from_.data, from_.size ) ) {
+              ends[ e ] = to_;
+              renamed = true;
+            }
+          }
+          if ( renamed ) {
+            prefixes_[ id ] = write_prefix( ends );
+          }
+        }
+      }
+
+      bool rewrite( const token_table & t, const std::size_t begin, const std::size_t end,
+                    const std::size_t, const span & formula, std::string & out ) const
+      {
+        std::vector< replacement > replacements;
+        for ( std::size_t i = begin; i < end; ++i ) {
+          const int id = t.name_ids[ i ];
+          if ( id == 0 || prefixes_[ id - 1 ].empty() ) {
+            continue;
+          }
+          const std::string & type = t.types[ i ];
+          std::size_t start = t.starts[ i ];
+          if ( ( type != "SHEETS" && type != "SHEETS-QUOTED" )
+               || ( start > 0 && formula.data[ start - 1 ] == ']' ) ) {
+            continue; // not a sheet, or in another workbook: [1]Sheet1!
+          }
+          if ( type == "SHEETS-QUOTED" ) {
+            --start; // the opening quote belongs to Prefix
+          }
+          replacements.push_back( replacement{ start, t.starts[ i ] + t.tokens[ i ].size,
+                                               prefixes_[ id - 1 ], false } );
+        }
+        return apply_replacements( formula, replacements, out );
+      }
+
+    private:
+      span from_;
+      span to_;
+      std::vector< std::string > prefixes_;
+  };
+
+} // xltoken
+
+#endif
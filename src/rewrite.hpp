@@ -0,0 +1,162 @@
+#ifndef XLTOKEN_REWRITE_HPP
+#define XLTOKEN_REWRITE_HPP
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include "xltoken.hpp"
+#include "lru_cache.hpp"
+#include "scheduler.hpp"
+
+namespace xltoken
+{
+
+  // Rewriting some tokens of formulas in bulk, e.g. references or sheet
+  // names, copying everything else byte for byte.
+
+  // Text to put in place of the characters [begin, end) of a formula.  Where
+  // replacements overlap, e.g. because the grammar emitted a token more than
+  // once while trying alternatives, the one that starts first wins, then the
+  // longest, then the one that is preferred.
+  struct replacement
+  {
+    std::size_t begin;
+    std::size_t end;
+    std::string text;
+    bool preferred;
+
+    bool operator<( const replacement & other ) const
+    {
+      if ( begin != other.begin ) return begin < other.begin;
+      if ( end != other.end ) return end > other.end;
+      return preferred > other.preferred;
+    }
+  };
+
+  // Make replacements in a formula.  Returns whether that changed it, in
+  // which case the rewritten formula is in 'out'.
+  inline bool apply_replacements( const span & text,
+                                  std::vector< replacement > & replacements,
+                                  std::string & out )
+  {
+    if ( replacements.empty() ) {
+      return false;
+    }
+    std::sort( replacements.begin(), replacements.end() );
+    out.clear();
+    std::size_t copied = 0;
+    for ( std::size_t r = 0; r < replacements.size(); ++r ) {
+      if ( replacements[ r ].begin < copied ) {
+        continue; // within one already made
+      }
+      out.append( text.data + copied, replacements[ r ].begin - copied );
+      out += replacements[ r ].text;
+      copied = replacements[ r ].end;
+    }
+    out.append( text.data + copied, text.size - copied );
+    return out.size() != text.size || out.compare( 0, out.size(), text.data, text.size ) != 0;
+  }
+
+  // Whether a formula could mention a sheet anywhere, ignoring case.  The
+  // name might be quoted with '' for ', so only what comes before the first
+  // ' is looked for.
+  inline bool mentions( const span & text, const span & sheet )
+  {
+    const std::size_t n = std::find( sheet.data, sheet.data + sheet.size, '\'' ) - sheet.data;
+    for ( std::size_t i = 0; i + n <= text.size; ++i ) {
+      if ( equal_folded( span( sheet.data, n ), text.data + i, n ) ) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  namespace rewrite_detail
+  {
+
+    template< typename Rewriter >
+      void run( const std::vector< span > & formulas,
+                Rewriter rewriter,
+                formula_tasks & tasks,
+                const unsigned thread,
+                std::vector< std::string > & out,
+                std::vector< char > & changed )
+      {
+        std::vector< char > parsed;
+        std::size_t first, last;
+        while ( tasks.next( thread, first, last ) ) {
+          token_table table;
+          parsed.assign( last - first, 0 );
+          for ( std::size_t f = first; f < last; ++f ) {
+            const span & formula = formulas[ f ];
+            if ( formula.is_na() || !rewriter.wanted( f, formula ) ) {
+              continue;
+            }
+            table.formula = f - first + 1;
+            try {
+              parsed[ f - first ] = tokenize_formula( formula, table );
+            } catch ( const parse_error & ) {
+            }
+          }
+          rewriter.batch( table );
+
+          // Tokens are in formula order, so walk them formula by formula
+          for ( std::size_t i = 0, j = 0; i < table.size(); i = j ) {
+            const int id = table.formula_ids[ i ];
+            while ( j < table.size() && table.formula_ids[ j ] == id ) {
+              ++j;
+            }
+            const std::size_t f = first + id - 1;
+            if ( parsed[ id - 1 ] ) {
+              changed[ f ] = rewriter.rewrite( table, i, j, f, formulas[ f ], out[ f ] );
+            }
+          }
+        }
+      }
+
+  } // rewrite_detail
+
+  // Tokenize and rewrite many formulas on 'threads' threads, which take
+  // tasks of at most 'batch' formulas at a time, stealing them from each
+  // other as they run out.  Each thread has its own copy of the rewriter,
+  // which has three methods:
+  // * bool wanted( std::size_t f, const span & formula ): whether formula f
+  //   might need rewriting.  If not, it isn't even tokenized.
+  // * void batch( const token_table & ): called with the tokens of each batch
+  //   before its formulas are rewritten.
+  // * bool rewrite( const token_table &, std::size_t begin, std::size_t end,
+  //                 std::size_t f, const span & formula, std::string & out ):
+  //   rewrite formula f, given its tokens [begin, end), returning whether it
+  //   changed.
+  //
+  // Where changed[f] is true, the rewritten formula is out[f], otherwise the
+  // formula is unchanged, including when it can't be parsed.
+  template< typename Rewriter >
+    void rewrite_formulas( const std::vector< span > & formulas,
+                           const Rewriter & rewriter,
+                           const unsigned threads,
+                           std::vector< std::string > & out,
+                           std::vector< bool > & changed,
+                           const std::size_t batch = 4096 )
+    {
+      const std::size_t n = formulas.size();
+      out.assign( n, std::string() );
+      std::vector< char > done( n, 0 ); // not vector< bool >, which threads can't share
+      formula_tasks tasks( formulas, threads, batch );
+      std::vector< std::thread > workers;
+      for ( unsigned t = 1; t < threads; ++t ) {
+        workers.push_back( std::thread( rewrite_detail::run< Rewriter >,
+                                        std::cref( formulas ), rewriter, std::ref( tasks ),
+                                        t, std::ref( out ), std::ref( done ) ) );
+      }
+      rewrite_detail::run( formulas, rewriter, tasks, 0, out, done );
+      for ( std::size_t t = 0; t < workers.size(); ++t ) {
+        workers[ t ].join();
+      }
+      changed.assign( done.begin(), done.end() );
+    }
+
+} // xltoken
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef XLTOKEN_SCHEDULER_HPP
+#define XLTOKEN_SCHEDULER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "arena.hpp"
+
+namespace xltoken
+{
+
+  // Formulas split into tasks of consecutive formulas for threads to
+  // tokenize, which steal tasks from each other when they run out.
+  //
+  // The lengths of formulas are very skewed, and so is the time to tokenize
+  // them, so a task is at most 'batch' formulas or about task_bytes of them,
+  // whichever is fewer, and a formula of more than big_formula bytes is a
+  // task of its own.  A thread that's left with a big formula to the end is
+  // then as late as the threads ever need to be.
+  //
+  // Each thread starts with an even share of the tasks, in order, as a
+  // range [begin, end) in one atomic word.  It takes tasks from the begin
+  // of its own range, and when that's empty, steals the back half of the
+  // range of the thread with the most left, with compare-and-swap, so
+  // nothing locks.
+  class formula_tasks
+  {
+    public:
+      static const std::size_t task_bytes = 16 * 1024;
+      static const std::size_t big_formula = 2 * 1024;
+
+      formula_tasks( const std::vector< span > & formulas,
+                     const unsigned threads,
+                     const std::size_t batch )
+        : ranges_( std::max( threads, 1u ) )
+      {
+        const std::size_t n = formulas.size();
+        const std::size_t most = std::max< std::size_t >( batch, 1 );
+        starts_.push_back( 0 );
+        for ( std::size_t f = 0, count = 0, bytes = 0; f < n; ++f ) {
+          const std::size_t size = formulas[ f ].size;
+          if ( count > 0 && ( count == most || bytes + size > task_bytes || size > big_formula ) ) {
+            starts_.push_back( f );
+            count = bytes = 0;
+          }
+          ++count;
+          bytes += size;
+          if ( size > big_formula && f + 1 < n ) {
+            starts_.push_back( f + 1 );
+            count = bytes = 0;
+          }
+        }
+        if ( n == 0 ) {
+          starts_.clear();
+        }
+        const std::uint64_t tasks = starts_.size();
+        starts_.push_back( n );
+
+        const std::uint64_t m = ranges_.size();
+        for ( std::uint64_t t = 0; t < m; ++t ) {
+          ranges_[ t ].value = pack( tasks * t / m, tasks * ( t + 1 ) / m );
+        }
+      }
+
+      // The next formulas [first, last) for a thread, returning false when
+      // every task has been taken
+      bool next( const unsigned thread, std::size_t & first, std::size_t & last )
+      {
+        std::uint64_t task;
+        if ( !take( thread, task ) && !steal( thread, task ) ) {
+          return false;
+        }
+        first = starts_[ task ];
+        last = starts_[ task + 1 ];
+        return true;
+      }
+
+      std::size_t size() const { return starts_.size() - 1; }
+
+    private:
+      // Padded to a cache line, so that threads don't contend for lines
+      struct range
+      {
+        std::atomic< std::uint64_t > value;
+        char padding[ 64 - sizeof( std::atomic< std::uint64_t > ) ];
+
+        range() : value( 0 ) {}
+        range( const range & ) : value( 0 ) {}
+      };
+
+      std::vector< std::size_t > starts_;  // of each task, then the end
+      std::vector< range > ranges_;        // of tasks, for each thread
+
+      static std::uint64_t pack( const std::uint64_t begin, const std::uint64_t end )
+      {
+        return begin << 32 | end;
+      }
+
+      static std::uint64_t begin( const std::uint64_t r ) { return r >> 32; }
+      static std::uint64_t end( const std::uint64_t r ) { return r & 0xffffffff; }
+
+      // Take the first task of a thread's own range
+      bool take( const unsigned thread, std::uint64_t & task )
+      {
+        std::atomic< std::uint64_t > & own = ranges_[ thread ].value;
+        std::uint64_t r = own.load();
+        while ( begin( r ) < end( r ) ) {
+          if ( own.compare_exchange_weak( r, pack( begin( r ) + 1, end( r ) ) ) ) {
+            task = begin( r );
+            return true;
+          }
+        }
+        return false;
+      }
+
+      // Take the back half of the range of the thread with the most left,
+      // keeping the first task of it and putting the rest in our own range,
+      // which is empty, so only thieves can be looking at it
+      bool steal( const unsigned thread, std::uint64_t & task )
+      {
+        for ( ; ; ) {
+          std::size_t victim = ranges_.size();
+          std::uint64_t most = 0, r = 0;
+          for ( std::size_t t = 0; t < ranges_.size(); ++t ) {
+            const std::uint64_t v = ranges_[ t ].value.load();
+            if ( t != thread && end( v ) - begin( v ) > most && begin( v ) < end( v ) ) {
+              victim = t;
+              most = end( v ) - begin( v );
+              r = v;
+            }
+          }
+          if ( victim == ranges_.size() ) {
+            return false;
+          }
+          const std::uint64_t half = most - most / 2;
+          const std::uint64_t from = end( r ) - half;
+          if ( ranges_[ victim ].value.compare_exchange_strong( r, pack( begin( r ), from ) ) ) {
+            task = from;
+            ranges_[ thread ].value.store( pack( from + 1, end( r ) ) );
+            return true;
+          }
+        }
+      }
+  };
+
+} // xltoken
+
+#endif
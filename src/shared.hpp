@@ -0,0 +1,325 @@
+#ifndef XLTOKEN_SHARED_HPP
+#define XLTOKEN_SHARED_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "xltoken.hpp"
+#include "references.hpp"
+#include "rewrite.hpp"
+
+namespace xltoken
+{
+
+  // Shared formulas: rectangular blocks of cells whose formulas are the same
+  // relative to each cell, e.g. =A1*2 in B1, =A2*2 in B2 and so on, which is
+  // =RC[-1]*2 in R1C1 style.  Each block can be stored as its top-left
+  // formula, the master, and its extent.
+
+  namespace shared_detail
+  {
+
+    // R5 if absolute, otherwise relative to the formula's own row: R, R[-1]
+    inline void write_r1c1( const char axis, const coordinate & c, const int own,
+                            std::string & out )
+    {
+      out += axis;
+      if ( c.absolute ) {
+        out += std::to_string( c.index );
+      } else if ( c.index != own ) {
+        out += '[';
+        out += std::to_string( c.index - own );
+        out += ']';
+      }
+    }
+
+  } // shared_detail
+
+  // Converts formulas to R1C1 style with rewrite_formulas(), where formula f
+  // is in rows[f] and cols[f].  Only the references are rewritten, so two
+  // formulas have the same R1C1 form exactly when one is a copy of the other.
+  // Every formula that parses is 'changed', even if it has no references, so
+  // those that don't parse are the only ones left out.
+  class r1c1_converter
+  {
+    public:
+      r1c1_converter( const std::vector< int > & rows, const std::vector< int > & cols )
+        : rows_( &rows ), cols_( &cols )
+      {}
+
+      bool wanted( const std::size_t, const span & ) const { return true; }
+
+      void batch( const token_table & ) {}
+
+      bool rewrite( const token_table & t, const std::size_t begin, const std::size_t end,
+                    const std::size_t f, const span & formula, std::string & out ) const
+      {
+        using shared_detail::write_r1c1;
+        const int row = ( *rows_ )[ f ];
+        const int col = ( *cols_ )[ f ];
+        std::vector< replacement > replacements;
+        for ( std::size_t i = begin; i < end; ++i ) {
+          const std::string & type = t.types[ i ];
+          const span & token = t.tokens[ i ];
+          std::string written;
+          if ( type == "CELL" ) {
+            cell_reference c;
+            if ( !parse_cell( token, c ) ) {
+              continue;
+            }
+            write_r1c1( 'R', c.row, row, written );
+            write_r1c1( 'C', c.col, col, written );
+          } else if ( type == "VERTICAL-RANGE" ) {
+            coordinate a, b;
+            if ( !parse_columns( token, a, b ) ) {
+              continue;
+            }
+            write_r1c1( 'C', a, col, written );
+            written += ':';
+            write_r1c1( 'C', b, col, written );
+          } else if ( type == "HORIZONTAL-RANGE" ) {
+            coordinate a, b;
+            if ( !parse_rows( token, a, b ) ) {
+              continue;
+            }
+            write_r1c1( 'R', a, row, written );
+            written += ':';
+            write_r1c1( 'R', b, row, written );
+          } else {
+            continue;
+          }
+          const std::size_t start = t.starts[ i ];
+          replacements.push_back( replacement{ start, start + token.size, written, false } );
+        }
+        if ( !apply_replacements( formula, replacements, out ) ) {
+          out.assign( formula.data, formula.size );
+        }
+        return true;
+      }
+
+    private:
+      const std::vector< int > * rows_;
+      const std::vector< int > * cols_;
+  };
+
+  // A block of cells with the same formula, as the index of its master, the
+  // formula in its top-left cell, and its extent
+  struct shared_block
+  {
+    int master;
+    int first_row;
+    int first_col;
+    int last_row;
+    int last_col;
+  };
+
+  // Find blocks of cells of one sheet whose formulas are in the same class,
+  // e.g. have the same R1C1 form.  classes[f] is the class of formula f, or 0
+  // for none.  Every formula with a class is in exactly one block, given in
+  // block_of, counting from 1; 0 means none.
+  //
+  // Cells are swept a row at a time, left to right.  A cell that isn't yet in
+  // a block starts one, which is as wide as the run of the same class to its
+  // right and as deep as the rows below that continue the whole run, or as
+  // deep as the run below it and as wide as the columns that continue that,
+  // whichever is bigger.  Fill-down and fill-right both come out whole.
+  inline void find_shared_blocks( const std::vector< int > & rows,
+                                  const std::vector< int > & cols,
+                                  const std::vector< int > & classes,
+                                  std::vector< shared_block > & blocks,
+                                  std::vector< int > & block_of )
+  {
+    const int n = classes.size();
+    blocks.clear();
+    block_of.assign( n, 0 );
+
+    std::unordered_map< std::uint64_t, int > at; // cell to formula
+    at.reserve( n );
+    std::vector< int > order;
+    for ( int f = 0; f < n; ++f ) {
+      if ( classes[ f ] != 0
+           && at.insert( std::make_pair( cell_key( 0, rows[ f ], cols[ f ] ), f ) ).second ) {
+        order.push_back( f );
+      }
+    }
+    std::sort( order.begin(), order.end(), [ & ]( const int a, const int b ) {
+      return rows[ a ] != rows[ b ] ? rows[ a ] < rows[ b ] : cols[ a ] < cols[ b ];
+    } );
+
+    // Whether a cell has a formula of the given class that isn't in a block
+    auto free = [ & ]( const int row, const int col, const int c ) {
+      if ( row > max_rows || col > max_cols ) {
+        return false;
+      }
+      std::unordered_map< std::uint64_t, int >::const_iterator it =
+        at.find( cell_key( 0, row, col ) );
+      return it != at.end() && classes[ it->second ] == c && block_of[ it->second ] == 0;
+    };
+    // How many rows of 'width' cells from (row, col) down are free, up to
+    // 'limit'
+    auto depth = [ & ]( const int row, const int col, const int width, const int c,
+                        const int limit ) {
+      int h = 1;
+      for ( ; h < limit; ++h ) {
+        for ( int w = 0; w < width; ++w ) {
+          if ( !free( row + h, col + w, c ) ) {
+            return h;
+          }
+        }
+      }
+      return h;
+    };
+
+    for ( std::size_t k = 0; k < order.size(); ++k ) {
+      const int f = order[ k ];
+      if ( block_of[ f ] != 0 ) {
+        continue;
+      }
+      const int row = rows[ f ];
+      const int col = cols[ f ];
+      const int c = classes[ f ];
+      int run_right = 1;
+      while ( free( row, col + run_right, c ) ) {
+        ++run_right;
+      }
+      int run_down = 1;
+      while ( free( row + run_down, col, c ) ) {
+        ++run_down;
+      }
+      // Wide, then as deep as the whole width continues
+      const int deep = depth( row, col, run_right, c, run_down );
+      // Deep, then as wide as the whole depth continues
+      int wide = 1;
+      for ( ; wide < run_right; ++wide ) {
+        if ( depth( row, col + wide, 1, c, run_down ) < run_down ) {
+          break;
+        }
+      }
+      int width = run_right;
+      int height = deep;
+      if ( wide * run_down > width * height ) {
+        width = wide;
+        height = run_down;
+      }
+
+      shared_block b;
+      b.master = f;
+      b.first_row = row;
+      b.first_col = col;
+      b.last_row = row + height - 1;
+      b.last_col = col + width - 1;
+      blocks.push_back( b );
+      for ( int r = row; r <= b.last_row; ++r ) {
+        for ( int q = col; q <= b.last_col; ++q ) {
+          block_of[ at[ cell_key( 0, r, q ) ] ] = blocks.size();
+        }
+      }
+    }
+
+    // Formulas in a cell that had already been seen are blocks of their own
+    for ( int f = 0; f < n; ++f ) {
+      if ( classes[ f ] != 0 && block_of[ f ] == 0 ) {
+        shared_block b;
+        b.master = f;
+        b.first_row = b.last_row = rows[ f ];
+        b.first_col = b.last_col = cols[ f ];
+        blocks.push_back( b );
+        block_of[ f ] = blocks.size();
+      }
+    }
+  }
+
+  // A formula that differs from the same formula on either side of it,
+  // either across its row or down its column, as Excel's "inconsistent
+  // formula" check finds them
+  struct inconsistency
+  {
+    int formula;
+    int neighbour; // one of those it differs from
+    bool rows;     // its neighbours are across its row, otherwise its column
+  };
+
+  // Find formulas of one sheet that are inconsistent with their neighbours,
+  // given the classes of the formulas as for find_shared_blocks().  A formula
+  // in a class is inconsistent if the cells either side of it, left and
+  // right or above and below, have formulas that are in the same class as
+  // each other but not its own.  Where it's both, it's only reported across
+  // its row.
+  //
+  // The cells are sorted by row then column, so left and right are next to
+  // each other, and each row is swept alongside the rows above and below it.
+  inline void find_inconsistent( const std::vector< int > & rows,
+                                 const std::vector< int > & cols,
+                                 const std::vector< int > & classes,
+                                 std::vector< inconsistency > & out )
+  {
+    out.clear();
+    std::vector< int > order;
+    for ( std::size_t f = 0; f < classes.size(); ++f ) {
+      if ( classes[ f ] != 0 ) {
+        order.push_back( f );
+      }
+    }
+    std::stable_sort( order.begin(), order.end(), [ & ]( const int a, const int b ) {
+      return rows[ a ] != rows[ b ] ? rows[ a ] < rows[ b ] : cols[ a ] < cols[ b ];
+    } );
+    // A formula in a cell that had already been seen is ignored, keeping the
+    // first, as find_shared_blocks() does
+    order.erase( std::unique( order.begin(), order.end(), [ & ]( const int a, const int b ) {
+      return rows[ a ] == rows[ b ] && cols[ a ] == cols[ b ];
+    } ), order.end() );
+
+    const std::size_t n = order.size();
+    std::size_t previous = 0; // where the previous row begins
+    for ( std::size_t begin = 0, end = 0; begin < n; previous = begin, begin = end ) {
+      const int row = rows[ order[ begin ] ];
+      while ( end < n && rows[ order[ end ] ] == row ) {
+        ++end;
+      }
+      // The rows above and below, which are empty unless they're adjacent
+      std::size_t above = begin;
+      const std::size_t above_end = begin;
+      if ( begin > 0 && rows[ order[ begin - 1 ] ] == row - 1 ) {
+        above = previous;
+      }
+      std::size_t below = end;
+      std::size_t below_end = end;
+      while ( below_end < n && rows[ order[ below_end ] ] == row + 1 ) {
+        ++below_end;
+      }
+
+      for ( std::size_t k = begin; k < end; ++k ) {
+        const int f = order[ k ];
+        const int col = cols[ f ];
+        const int c = classes[ f ];
+        if ( k > begin && k + 1 < end
+             && cols[ order[ k - 1 ] ] == col - 1 && cols[ order[ k + 1 ] ] == col + 1 ) {
+          const int left = order[ k - 1 ];
+          if ( classes[ left ] != c && classes[ left ] == classes[ order[ k + 1 ] ] ) {
+            out.push_back( inconsistency{ f, left, true } );
+            continue;
+          }
+        }
+        // Both neighbouring rows are in column order too, so only move on
+        while ( above < above_end && cols[ order[ above ] ] < col ) {
+          ++above;
+        }
+        while ( below < below_end && cols[ order[ below ] ] < col ) {
+          ++below;
+        }
+        if ( above < above_end && below < below_end
+             && cols[ order[ above ] ] == col && cols[ order[ below ] ] == col ) {
+          const int up = order[ above ];
+          if ( classes[ up ] != c && classes[ up ] == classes[ order[ below ] ] ) {
+            out.push_back( inconsistency{ f, up, false } );
+          }
+        }
+      }
+    }
+  }
+
+} // xltoken
+
+#endif
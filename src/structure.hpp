@@ -0,0 +1,236 @@
+#ifndef XLTOKEN_STRUCTURE_HPP
+#define XLTOKEN_STRUCTURE_HPP
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "xltoken.hpp"
+#include "references.hpp"
+#include "rewrite.hpp"
+
+namespace xltoken
+{
+
+  // Inserting or deleting rows or columns of a sheet, and rewriting the
+  // references to that sheet to follow the cells they referred to, the way
+  // Excel does.
+
+  // Insert 'count' rows or columns before 'index', or delete -count of them
+  // from 'index', counting from 1
+  struct structural_edit
+  {
+    span sheet;
+    bool rows;     // otherwise columns
+    int index;
+    int count;
+  };
+
+  namespace structure_detail
+  {
+
+    // Where a row or column moves to, or 0 if it's deleted or pushed off the
+    // sheet
+    inline int shift( const int at, const structural_edit & e, const int max )
+    {
+      if ( at < e.index ) {
+        return at;
+      }
+      if ( e.count < 0 && at < e.index - e.count ) {
+        return 0;
+      }
+      return at + e.count > max ? 0 : at + e.count;
+    }
+
+    // Where the ends of a range move to.  Deleting one end moves it to the
+    // nearest row or column that remains.  Returns false if the whole range
+    // is deleted.
+    inline bool shift( int & first, int & last, const structural_edit & e, const int max )
+    {
+      if ( e.count > 0 ) {
+        first = shift( first, e, max );
+        last = std::min( last >= e.index ? last + e.count : last, max );
+        return first != 0;
+      }
+      const int end = e.index - e.count; // first one after those deleted
+      if ( first >= e.index && last < end ) {
+        return false;
+      }
+      first = first < e.index ? first : std::max( first, end ) + e.count;
+      last = last < e.index ? last : last < end ? e.index - 1 : last + e.count;
+      return true;
+    }
+
+    inline void write_column( const coordinate & c, std::string & out )
+    {
+      if ( c.absolute ) {
+        out += '$';
+      }
+      char letters[ 4 ];
+      int n = 0;
+      for ( int i = c.index; i > 0; i = ( i - 1 ) / 26 ) {
+        letters[ n++ ] = 'A' + ( i - 1 ) % 26;
+      }
+      while ( n > 0 ) {
+        out += letters[ --n ];
+      }
+    }
+
+    inline void write_row( const coordinate & c, std::string & out )
+    {
+      if ( c.absolute ) {
+        out += '$';
+      }
+      out += std::to_string( c.index );
+    }
+
+    inline std::string write_cell( const cell_reference & c )
+    {
+      std::string out;
+      write_column( c.col, out );
+      write_row( c.row, out );
+      return out;
+    }
+
+  } // structure_detail
+
+  // Rewrite the references of one formula, the tokens [begin, end) of a
+  // table, for a structural edit.  References without a sheet prefix are to
+  // the formula's own sheet, which 'on_sheet' says is the edited one.
+  // References to other workbooks, and 3D references such as Sheet1:Sheet3!A1,
+  // are left alone.  Returns whether anything changed, in which case the
+  // rewritten formula is in 'out'.  Everything but the rewritten references
+  // is copied byte for byte.
+  inline bool shift_references( const token_table & t,
+                                const std::size_t begin,
+                                const std::size_t end,
+                                const span & text,
+                                const bool on_sheet,
+                                const structural_edit & e,
+                                std::string & out )
+  {
+    using structure_detail::shift;
+    using structure_detail::write_cell;
+    using structure_detail::write_column;
+    using structure_detail::write_row;
+    const int max = e.rows ? max_rows : max_cols;
+    std::vector< replacement > replacements;
+    bool prefixed = false;
+    const char * prefix_end = nullptr;
+    for ( std::size_t i = begin; i < end; ++i ) {
+      const std::string & type = t.types[ i ];
+      const span & token = t.tokens[ i ];
+      if ( type == "SHEETS" || type == "SHEETS-QUOTED" ) {
+        const span & name = t.names.strings()[ t.name_ids[ i ] - 1 ];
+        prefixed = !( t.starts[ i ] > 0 && token.data[ -1 ] == ']' )
+                   && equal_folded( name, e.sheet.data, e.sheet.size );
+        prefix_end = token.data + token.size;
+        continue;
+      }
+      if ( !( token.data == prefix_end ? prefixed : on_sheet ) ) {
+        continue;
+      }
+      const std::size_t start = t.starts[ i ];
+      if ( type == "CELL" ) {
+        cell_reference first;
+        if ( !parse_cell( token, first ) ) {
+          continue;
+        }
+        coordinate & a = e.rows ? first.row : first.col;
+        cell_reference last;
+        if ( i + 2 < end
+             && t.types[ i + 1 ] == "RANGE-OP"
+             && t.types[ i + 2 ] == "CELL"
+             && t.tokens[ i + 1 ].data == token.data + token.size
+             && parse_cell( t.tokens[ i + 2 ], last ) ) {
+          // A1:B2 is three tokens, and may be written backwards, B2:A1
+          coordinate & b = e.rows ? last.row : last.col;
+          coordinate & low = a.index <= b.index ? a : b;
+          coordinate & high = a.index <= b.index ? b : a;
+          // Both ends are written even if they don't move, to override any
+          // cell that the grammar also emitted on its own
+          const std::size_t last_start = t.starts[ i + 2 ];
+          const std::size_t range_end = last_start + t.tokens[ i + 2 ].size;
+          if ( !shift( low.index, high.index, e, max ) ) {
+            replacements.push_back( replacement{ start, range_end, "#REF!", true } );
+          } else {
+            replacements.push_back( replacement{ start, start + token.size,
+                                                 write_cell( first ), true } );
+            replacements.push_back( replacement{ last_start, range_end,
+                                                 write_cell( last ), true } );
+          }
+          i += 2;
+          continue;
+        }
+        const int old_a = a.index;
+        a.index = shift( a.index, e, max );
+        if ( a.index == 0 ) {
+          replacements.push_back( replacement{ start, start + token.size, "#REF!", false } );
+        } else if ( a.index != old_a ) {
+          replacements.push_back( replacement{ start, start + token.size,
+                                               write_cell( first ), false } );
+        }
+      } else if ( ( type == "VERTICAL-RANGE" && !e.rows )
+                  || ( type == "HORIZONTAL-RANGE" && e.rows ) ) {
+        coordinate a, b;
+        if ( !( e.rows ? parse_rows( token, a, b ) : parse_columns( token, a, b ) ) ) {
+          continue;
+        }
+        coordinate & low = a.index <= b.index ? a : b;
+        coordinate & high = a.index <= b.index ? b : a;
+        std::string written;
+        if ( !shift( low.index, high.index, e, max ) ) {
+          written = "#REF!";
+        } else if ( e.rows ) {
+          write_row( a, written );
+          written += ':';
+          write_row( b, written );
+        } else {
+          write_column( a, written );
+          written += ':';
+          write_column( b, written );
+        }
+        if ( written != token.string() ) {
+          replacements.push_back( replacement{ start, start + token.size, written, false } );
+        }
+      }
+    }
+    return apply_replacements( text, replacements, out );
+  }
+
+  // Rewrites the references of many formulas with rewrite_formulas(), where
+  // the sheet of formula f is sheets[f].  A formula on another sheet that
+  // doesn't mention the edited sheet can't refer to it, so isn't tokenized.
+  class reference_shifter
+  {
+    public:
+      reference_shifter( const std::vector< span > & sheets, const structural_edit & e )
+        : sheets_( &sheets ), edit_( e )
+      {}
+
+      bool wanted( const std::size_t f, const span & formula ) const
+      {
+        return on_sheet( f ) || mentions( formula, edit_.sheet );
+      }
+
+      void batch( const token_table & ) {}
+
+      bool rewrite( const token_table & t, const std::size_t begin, const std::size_t end,
+                    const std::size_t f, const span & formula, std::string & out ) const
+      {
+        return shift_references( t, begin, end, formula, on_sheet( f ), edit_, out );
+      }
+
+    private:
+      const std::vector< span > * sheets_;
+      structural_edit edit_;
+
+      bool on_sheet( const std::size_t f ) const
+      {
+        const span & sheet = ( *sheets_ )[ f ];
+        return equal_folded( sheet, edit_.sheet.data, edit_.sheet.size );
+      }
+  };
+
+} // xltoken
+
+#endif
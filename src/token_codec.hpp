@@ -0,0 +1,285 @@
+#ifndef XLTOKEN_TOKEN_CODEC_HPP
+#define XLTOKEN_TOKEN_CODEC_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include "token_table.hpp"
+
+namespace xltoken
+{
+
+  // Keys for formulas, and a compact encoding of their tokens, for caches of
+  // tokens that outlive a batch.
+
+  namespace codec_detail
+  {
+
+    inline std::uint64_t rotl( const std::uint64_t x, const int r )
+    {
+      return ( x << r ) | ( x >> ( 64 - r ) );
+    }
+
+    inline std::uint64_t fmix( std::uint64_t k )
+    {
+      k ^= k >> 33;
+      k *= 0xff51afd7ed558ccdULL;
+      k ^= k >> 33;
+      k *= 0xc4ceb9fe1a85ec53ULL;
+      k ^= k >> 33;
+      return k;
+    }
+
+  } // codec_detail
+
+  // A 128-bit hash of a formula
+  struct formula_key
+  {
+    std::uint64_t low;
+    std::uint64_t high;
+
+    bool operator==( const formula_key & other ) const
+    {
+      return low == other.low && high == other.high;
+    }
+  };
+
+  // MurmurHash3_x64_128, with both halves of the state seeded
+  inline formula_key murmur3( const char * data, const std::size_t n, const formula_key & seed )
+  {
+    const std::uint64_t c1 = 0x87c37b91114253d5ULL;
+    const std::uint64_t c2 = 0x4cf5ad432745937fULL;
+    std::uint64_t h1 = seed.low;
+    std::uint64_t h2 = seed.high;
+    const std::size_t blocks = n / 16;
+    for ( std::size_t i = 0; i < blocks; ++i ) {
+      std::uint64_t k1, k2;
+      std::memcpy( &k1, data + 16 * i, 8 );
+      std::memcpy( &k2, data + 16 * i + 8, 8 );
+      k1 *= c1; k1 = codec_detail::rotl( k1, 31 ); k1 *= c2; h1 ^= k1;
+      h1 = codec_detail::rotl( h1, 27 ); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+      k2 *= c2; k2 = codec_detail::rotl( k2, 33 ); k2 *= c1; h2 ^= k2;
+      h2 = codec_detail::rotl( h2, 31 ); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+    const unsigned char * tail = reinterpret_cast< const unsigned char * >( data + 16 * blocks );
+    std::uint64_t k1 = 0, k2 = 0;
+    switch ( n & 15 ) {
+      case 15: k2 ^= std::uint64_t( tail[ 14 ] ) << 48; // fall through
+      case 14: k2 ^= std::uint64_t( tail[ 13 ] ) << 40; // fall through
+      case 13: k2 ^= std::uint64_t( tail[ 12 ] ) << 32; // fall through
+      case 12: k2 ^= std::uint64_t( tail[ 11 ] ) << 24; // fall through
+      case 11: k2 ^= std::uint64_t( tail[ 10 ] ) << 16; // fall through
+      case 10: k2 ^= std::uint64_t( tail[ 9 ] ) << 8;   // fall through
+      case 9:  k2 ^= std::uint64_t( tail[ 8 ] );
+               k2 *= c2; k2 = codec_detail::rotl( k2, 33 ); k2 *= c1; h2 ^= k2; // fall through
+      case 8:  k1 ^= std::uint64_t( tail[ 7 ] ) << 56; // fall through
+      case 7:  k1 ^= std::uint64_t( tail[ 6 ] ) << 48; // fall through
+      case 6:  k1 ^= std::uint64_t( tail[ 5 ] ) << 40; // fall through
+      case 5:  k1 ^= std::uint64_t( tail[ 4 ] ) << 32; // fall through
+      case 4:  k1 ^= std::uint64_t( tail[ 3 ] ) << 24; // fall through
+      case 3:  k1 ^= std::uint64_t( tail[ 2 ] ) << 16; // fall through
+      case 2:  k1 ^= std::uint64_t( tail[ 1 ] ) << 8;  // fall through
+      case 1:  k1 ^= std::uint64_t( tail[ 0 ] );
+               k1 *= c1; k1 = codec_detail::rotl( k1, 31 ); k1 *= c2; h1 ^= k1;
+    }
+    h1 ^= n; h2 ^= n;
+    h1 += h2; h2 += h1;
+    h1 = codec_detail::fmix( h1 ); h2 = codec_detail::fmix( h2 );
+    h1 += h2; h2 += h1;
+    return formula_key{ h1, h2 };
+  }
+
+  // The tokens of one formula, rows [begin, end) of a table, encoded so that
+  // decode_tokens() can append them to another table.  Tokens are spans of
+  // the formula, and so are nearly all of their values and names, which are
+  // stored as where they are.
+  inline void encode_tokens( const token_table & t,
+                             const std::size_t begin,
+                             const std::size_t end,
+                             const span & formula,
+                             std::string & out )
+  {
+    auto u32 = [ & ]( const std::uint32_t x ) {
+      out.append( reinterpret_cast< const char * >( &x ), 4 );
+    };
+    auto bytes = [ & ]( const span & s ) {
+      u32( s.size );
+      out.append( s.data, s.size );
+    };
+    auto within = [ & ]( const span & s ) {
+      return s.data >= formula.data && s.data + s.size <= formula.data + formula.size;
+    };
+    out.clear();
+    u32( end - begin );
+    for ( std::size_t i = begin; i < end; ++i ) {
+      const std::string & type = t.types[ i ];
+      out += static_cast< char >( type.size() );
+      out += type;
+      u32( t.starts[ i ] );
+      u32( t.tokens[ i ].size );
+
+      const span & value = t.values[ i ];
+      if ( value.is_na() ) {
+        out += '\0';
+      } else if ( within( value ) ) {
+        out += '\1';
+        u32( value.data - formula.data );
+        u32( value.size );
+      } else {
+        out += '\2';
+        bytes( value );
+      }
+
+      const double number = t.numbers[ i ];
+      if ( number != number ) {
+        out += '\0';
+      } else {
+        out += '\1';
+        out.append( reinterpret_cast< const char * >( &number ), 8 );
+      }
+
+      // A name is interned as the token spells it, which is its value or
+      // the start of the token
+      if ( t.name_ids[ i ] == 0 ) {
+        out += '\0';
+        continue;
+      }
+      const span & name = t.names.strings()[ t.name_ids[ i ] - 1 ];
+      const span & token = t.tokens[ i ];
+      if ( !value.is_na() && equal_folded( value, name.data, name.size ) ) {
+        out += '\1';
+      } else if ( name.size <= token.size && equal_folded( name, token.data, name.size ) ) {
+        out += '\2';
+        u32( name.size );
+      } else {
+        out += '\3';
+        bytes( name );
+      }
+    }
+  }
+
+  // Append the tokens of a formula, as from encode_tokens(), to a table.
+  // Returns false, leaving the table as it was, if they don't fit the
+  // formula.
+  inline bool decode_tokens( const char * data,
+                             const std::size_t size,
+                             const span & formula,
+                             token_table & t )
+  {
+    const char * end = data + size;
+    bool ok = true;
+    auto u32 = [ & ]() {
+      std::uint32_t x = 0;
+      if ( end - data < 4 ) {
+        ok = false;
+        return x;
+      }
+      std::memcpy( &x, data, 4 );
+      data += 4;
+      return x;
+    };
+    auto u8 = [ & ]() {
+      if ( data == end ) {
+        ok = false;
+        return '\0';
+      }
+      return *data++;
+    };
+    auto bytes = [ & ]( const std::size_t n ) {
+      if ( static_cast< std::size_t >( end - data ) < n ) {
+        ok = false;
+        return span( data, 0 );
+      }
+      data += n;
+      return span( data - n, n );
+    };
+
+    const std::size_t rows = t.size();
+    const std::uint32_t n = u32();
+    for ( std::uint32_t k = 0; ok && k < n; ++k ) {
+      const span type = bytes( static_cast< unsigned char >( u8() ) );
+      const std::uint32_t start = u32();
+      const std::uint32_t length = u32();
+      ok = ok && start <= formula.size && length <= formula.size - start;
+      const span token( formula.data + start, length );
+
+      span value;
+      switch ( u8() ) {
+        case '\0':
+          break;
+        case '\1': {
+          const std::uint32_t at = u32();
+          const std::uint32_t size = u32();
+          ok = ok && at <= formula.size && size <= formula.size - at;
+          value = span( formula.data + at, size );
+          break;
+        }
+        case '\2': {
+          const span s = bytes( u32() );
+          value = t.strings.store( s.data, s.size );
+          break;
+        }
+        default:
+          ok = false;
+      }
+
+      double number = std::numeric_limits< double >::quiet_NaN();
+      switch ( u8() ) {
+        case '\0':
+          break;
+        case '\1': {
+          const span s = bytes( 8 );
+          if ( ok ) {
+            std::memcpy( &number, s.data, 8 );
+          }
+          break;
+        }
+        default:
+          ok = false;
+      }
+
+      int name_id = 0;
+      switch ( u8() ) {
+        case '\0':
+          break;
+        case '\1':
+          ok = ok && !value.is_na();
+          name_id = ok ? t.names.intern( value ) : 0;
+          break;
+        case '\2': {
+          const std::uint32_t size = u32();
+          ok = ok && size <= token.size;
+          name_id = ok ? t.names.intern( span( token.data, size ) ) : 0;
+          break;
+        }
+        case '\3': {
+          const span s = bytes( u32() );
+          name_id = ok ? t.names.intern( s, t.strings ) : 0;
+          break;
+        }
+        default:
+          ok = false;
+      }
+      if ( !ok ) {
+        break;
+      }
+
+      t.formula_ids.push_back( t.formula );
+      t.types.push_back( type.string() );
+      t.tokens.push_back( token );
+      t.starts.push_back( start );
+      t.values.push_back( value );
+      t.numbers.push_back( number );
+      t.name_ids.push_back( name_id );
+    }
+    if ( !ok || data != end ) {
+      t.truncate( rows ); // names interned meanwhile stay, unused
+      return false;
+    }
+    return true;
+  }
+
+} // xltoken
+
+#endif
@@ -0,0 +1,477 @@
+#ifndef XLTOKEN_TOKEN_FILE_HPP
+#define XLTOKEN_TOKEN_FILE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "token_table.hpp"
+#include "references.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace xltoken
+{
+
+  // Token tables on disk, so that formulas needn't be tokenized again.
+  //
+  // The file is a header followed by columns, each starting at a multiple of
+  // 8 bytes, so that a reader can map the file into memory and use the
+  // columns where they are:
+  //
+  //   formula offsets  uint64[formulas + 1]  tokens of formula f, counting
+  //                                          from 1, are [offsets[f - 1],
+  //                                          offsets[f])
+  //   type ids         uint32[types]         the string of each type code
+  //   type codes       uint16[tokens]
+  //   starts           int32[tokens]         from 0, within the formula
+  //   lengths          int32[tokens]
+  //   token ids        uint32[tokens]        string ids
+  //   value ids        uint32[tokens]        string ids, 0 for NA
+  //   numbers          double[tokens]        NaN for none
+  //   name codes       int32[tokens]         from 1, 0 for none
+  //   name ids         uint32[names]         the string of each name code
+  //   definitions      int32[tokens]         from 1, 0 for none
+  //   rows             int32[tokens]         of CELL tokens, 0 otherwise
+  //   cols             int32[tokens]         of CELL tokens, 0 otherwise
+  //   string offsets   uint64[strings + 1]   string i, counting from 1, is
+  //                                          bytes [offsets[i - 1], offsets[i])
+  //   string bytes     char[bytes]
+  //
+  // Numbers are in the byte order of the machine that wrote the file, which
+  // readers check.  The version changes whenever the layout does.
+
+  const char token_file_magic[ 8 ] = { 'X', 'L', 'T', 'O', 'K', 'E', 'N', 'S' };
+  const std::uint32_t token_file_version = 1;
+  const std::uint32_t token_file_byte_order = 0x01020304;
+
+  struct token_file_header
+  {
+    char magic[ 8 ];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t formulas;
+    std::uint64_t tokens;
+    std::uint64_t types;
+    std::uint64_t names;
+    std::uint64_t strings;
+    std::uint64_t bytes;
+  };
+
+  // Where each column starts, and the size of the file, given its header
+  struct token_file_layout
+  {
+    std::uint64_t formula_offsets;
+    std::uint64_t type_ids;
+    std::uint64_t type_codes;
+    std::uint64_t starts;
+    std::uint64_t lengths;
+    std::uint64_t token_ids;
+    std::uint64_t value_ids;
+    std::uint64_t numbers;
+    std::uint64_t name_codes;
+    std::uint64_t name_ids;
+    std::uint64_t definitions;
+    std::uint64_t rows;
+    std::uint64_t cols;
+    std::uint64_t string_offsets;
+    std::uint64_t string_bytes;
+    std::uint64_t size;
+
+    explicit token_file_layout( const token_file_header & h )
+    {
+      size = sizeof( token_file_header );
+      formula_offsets = column( 8 * ( h.formulas + 1 ) );
+      type_ids = column( 4 * h.types );
+      type_codes = column( 2 * h.tokens );
+      starts = column( 4 * h.tokens );
+      lengths = column( 4 * h.tokens );
+      token_ids = column( 4 * h.tokens );
+      value_ids = column( 4 * h.tokens );
+      numbers = column( 8 * h.tokens );
+      name_codes = column( 4 * h.tokens );
+      name_ids = column( 4 * h.names );
+      definitions = column( 4 * h.tokens );
+      rows = column( 4 * h.tokens );
+      cols = column( 4 * h.tokens );
+      string_offsets = column( 8 * ( h.strings + 1 ) );
+      string_bytes = column( h.bytes );
+    }
+
+    private:
+      std::uint64_t column( const std::uint64_t bytes )
+      {
+        const std::uint64_t at = size;
+        size = ( size + bytes + 7 ) & ~static_cast< std::uint64_t >( 7 );
+        return at;
+      }
+  };
+
+  namespace token_file_detail
+  {
+
+    class output
+    {
+      public:
+        explicit output( const std::string & path )
+          : path_( path ), file_( std::fopen( path.c_str(), "wb" ) ), at_( 0 )
+        {
+          if ( file_ == nullptr ) {
+            throw std::runtime_error( "Can't write to " + path );
+          }
+        }
+
+        ~output()
+        {
+          if ( file_ != nullptr ) {
+            std::fclose( file_ );
+          }
+        }
+
+        // Write a column, padded to a multiple of 8 bytes
+        void column( const void * data, const std::uint64_t bytes )
+        {
+          write( data, bytes );
+          pad();
+        }
+
+        template< typename T >
+          void column( const std::vector< T > & values )
+          {
+            column( values.data(), values.size() * sizeof( T ) );
+          }
+
+        void close()
+        {
+          const bool closed = std::fclose( file_ ) == 0;
+          file_ = nullptr;
+          if ( !closed ) {
+            throw std::runtime_error( "Can't write to " + path_ );
+          }
+        }
+
+        void write( const void * data, const std::uint64_t bytes )
+        {
+          if ( bytes != 0 && std::fwrite( data, 1, bytes, file_ ) != bytes ) {
+            throw std::runtime_error( "Can't write to " + path_ );
+          }
+          at_ += bytes;
+        }
+
+        void pad()
+        {
+          static const char padding[ 8 ] = { 0 };
+          write( padding, ( 8 - at_ % 8 ) % 8 );
+        }
+
+      private:
+        std::string path_;
+        std::FILE * file_;
+        std::uint64_t at_;
+    };
+
+  } // token_file_detail
+
+  // Write a table to a file, with the definitions of its NAME tokens as from
+  // name_table::resolve().  The tokens of each formula must be together, in
+  // order of formula id, as parse_formula() leaves them.  Throws
+  // std::runtime_error if the file can't be written.
+  inline void write_token_file( const std::string & path,
+                                const token_table & t,
+                                const std::vector< int > & definitions )
+  {
+    const std::size_t n = t.size();
+    token_file_header h;
+    std::memcpy( h.magic, token_file_magic, sizeof( h.magic ) );
+    h.version = token_file_version;
+    h.byte_order = token_file_byte_order;
+    h.tokens = n;
+    h.formulas = n == 0 ? 0 : t.formula_ids.back();
+    h.names = t.names.size();
+
+    std::vector< std::uint64_t > offsets( h.formulas + 1, 0 );
+    for ( std::size_t i = 0; i < n; ++i ) {
+      const int id = t.formula_ids[ i ];
+      if ( id < 1 || ( i > 0 && id < t.formula_ids[ i - 1 ] ) ) {
+        throw std::runtime_error( "Tokens must be in order of formula id, from 1" );
+      }
+      offsets[ id ] = i + 1;
+    }
+    for ( std::size_t f = 1; f < offsets.size(); ++f ) {
+      offsets[ f ] = std::max( offsets[ f ], offsets[ f - 1 ] ); // formulas without tokens
+    }
+
+    // Types are few, so are coded by looking back at the last one that was
+    // different
+    string_dictionary strings;
+    std::vector< std::uint32_t > type_ids;
+    std::vector< std::uint16_t > type_codes( n );
+    for ( std::size_t i = 0; i < n; ++i ) {
+      if ( i > 0 && t.types[ i ] == t.types[ i - 1 ] ) {
+        type_codes[ i ] = type_codes[ i - 1 ];
+        continue;
+      }
+      const std::string & type = t.types[ i ];
+      const std::uint32_t id = strings.intern( span( type.data(), type.size() ) );
+      std::size_t code = std::find( type_ids.begin(), type_ids.end(), id ) - type_ids.begin();
+      if ( code == type_ids.size() ) {
+        type_ids.push_back( id );
+      }
+      type_codes[ i ] = code;
+    }
+    h.types = type_ids.size();
+
+    std::vector< std::int32_t > starts( t.starts.begin(), t.starts.end() );
+    std::vector< std::int32_t > lengths( n ), rows( n, 0 ), cols( n, 0 );
+    std::vector< std::uint32_t > token_ids( n ), value_ids( n, 0 );
+    for ( std::size_t i = 0; i < n; ++i ) {
+      lengths[ i ] = t.tokens[ i ].size;
+      token_ids[ i ] = strings.intern( t.tokens[ i ] );
+      if ( !t.values[ i ].is_na() ) {
+        value_ids[ i ] = strings.intern( t.values[ i ] );
+      }
+      cell_reference c;
+      if ( t.types[ i ] == "CELL" && parse_cell( t.tokens[ i ], c ) ) {
+        rows[ i ] = c.row.index;
+        cols[ i ] = c.col.index;
+      }
+    }
+    std::vector< std::int32_t > name_codes( t.name_ids.begin(), t.name_ids.end() );
+    std::vector< std::uint32_t > name_ids( h.names );
+    for ( std::size_t d = 0; d < h.names; ++d ) {
+      name_ids[ d ] = strings.intern( t.names.strings()[ d ] );
+    }
+    std::vector< std::int32_t > defined( definitions.begin(), definitions.end() );
+    defined.resize( n, 0 );
+
+    h.strings = strings.strings().size();
+    h.bytes = strings.bytes();
+    std::vector< std::uint64_t > string_offsets( h.strings + 1, 0 );
+    for ( std::size_t s = 0; s < h.strings; ++s ) {
+      string_offsets[ s + 1 ] = string_offsets[ s ] + strings.strings()[ s ].size;
+    }
+
+    token_file_detail::output out( path );
+    out.column( &h, sizeof( h ) );
+    out.column( offsets );
+    out.column( type_ids );
+    out.column( type_codes );
+    out.column( starts );
+    out.column( lengths );
+    out.column( token_ids );
+    out.column( value_ids );
+    out.column( t.numbers );
+    out.column( name_codes );
+    out.column( name_ids );
+    out.column( defined );
+    out.column( rows );
+    out.column( cols );
+    out.column( string_offsets );
+    for ( std::size_t s = 0; s < h.strings; ++s ) {
+      out.write( strings.strings()[ s ].data, strings.strings()[ s ].size );
+    }
+    out.pad();
+    out.close();
+  }
+
+  // A file mapped into memory, read only
+  class mapped_file
+  {
+    public:
+      explicit mapped_file( const std::string & path )
+        : data_( nullptr ), size_( 0 )
+      {
+#ifdef _WIN32
+        mapping_ = nullptr;
+        file_ = CreateFileA( path.c_str(), GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+        LARGE_INTEGER size;
+        if ( file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx( file_, &size ) ) {
+          close();
+          throw std::runtime_error( "Can't read " + path );
+        }
+        size_ = size.QuadPart;
+        mapping_ = size_ == 0 ? nullptr
+                   : CreateFileMappingA( file_, nullptr, PAGE_READONLY, 0, 0, nullptr );
+        if ( mapping_ != nullptr ) {
+          data_ = static_cast< const char * >( MapViewOfFile( mapping_, FILE_MAP_READ, 0, 0, 0 ) );
+        }
+        if ( size_ != 0 && data_ == nullptr ) {
+          close();
+          throw std::runtime_error( "Can't map " + path );
+        }
+#else
+        file_ = open( path.c_str(), O_RDONLY );
+        struct stat status;
+        if ( file_ == -1 || fstat( file_, &status ) != 0 ) {
+          close();
+          throw std::runtime_error( "Can't read " + path );
+        }
+        size_ = status.st_size;
+        if ( size_ != 0 ) {
+          void * data = mmap( nullptr, size_, PROT_READ, MAP_SHARED, file_, 0 );
+          if ( data == MAP_FAILED ) {
+            close();
+            throw std::runtime_error( "Can't map " + path );
+          }
+          data_ = static_cast< const char * >( data );
+        }
+#endif
+      }
+
+      ~mapped_file() { close(); }
+
+      const char * data() const { return data_; }
+
+      std::size_t size() const { return size_; }
+
+    private:
+#ifdef _WIN32
+      HANDLE file_;
+      HANDLE mapping_;
+#else
+      int file_;
+#endif
+      const char * data_;
+      std::size_t size_;
+
+      mapped_file( const mapped_file & );
+      mapped_file & operator=( const mapped_file & );
+
+      void close()
+      {
+#ifdef _WIN32
+        if ( data_ != nullptr ) UnmapViewOfFile( data_ );
+        if ( mapping_ != nullptr ) CloseHandle( mapping_ );
+        if ( file_ != INVALID_HANDLE_VALUE ) CloseHandle( file_ );
+        file_ = INVALID_HANDLE_VALUE;
+        mapping_ = nullptr;
+#else
+        if ( data_ != nullptr ) munmap( const_cast< char * >( data_ ), size_ );
+        if ( file_ != -1 ) ::close( file_ );
+        file_ = -1;
+#endif
+        data_ = nullptr;
+      }
+  };
+
+  // A token file, mapped into memory.  The columns are read where they are,
+  // and strings are spans of the file, so they last as long as it does.
+  // Throws std::runtime_error if the file isn't a token file of this version
+  // and byte order, or is truncated, or its offsets are corrupt.
+  class token_file
+  {
+    public:
+      explicit token_file( const std::string & path )
+        : file_( path ), header_( check( file_, path ) ), layout_( header_ )
+      {
+        if ( layout_.size != file_.size() ) {
+          throw std::runtime_error( path + " is truncated" );
+        }
+        check_offsets( formula_offsets(), header_.formulas, header_.tokens, path );
+        check_offsets( at< std::uint64_t >( layout_.string_offsets ), header_.strings,
+                       header_.bytes, path );
+      }
+
+      const token_file_header & header() const { return header_; }
+
+      std::size_t formulas() const { return header_.formulas; }
+      std::size_t size() const { return header_.tokens; }
+
+      const std::uint64_t * formula_offsets() const { return at< std::uint64_t >( layout_.formula_offsets ); }
+      const std::uint32_t * type_ids() const { return at< std::uint32_t >( layout_.type_ids ); }
+      const std::uint16_t * type_codes() const { return at< std::uint16_t >( layout_.type_codes ); }
+      const std::int32_t * starts() const { return at< std::int32_t >( layout_.starts ); }
+      const std::int32_t * lengths() const { return at< std::int32_t >( layout_.lengths ); }
+      const std::uint32_t * token_ids() const { return at< std::uint32_t >( layout_.token_ids ); }
+      const std::uint32_t * value_ids() const { return at< std::uint32_t >( layout_.value_ids ); }
+      const double * numbers() const { return at< double >( layout_.numbers ); }
+      const std::int32_t * name_codes() const { return at< std::int32_t >( layout_.name_codes ); }
+      const std::uint32_t * name_ids() const { return at< std::uint32_t >( layout_.name_ids ); }
+      const std::int32_t * definitions() const { return at< std::int32_t >( layout_.definitions ); }
+      const std::int32_t * rows() const { return at< std::int32_t >( layout_.rows ); }
+      const std::int32_t * cols() const { return at< std::int32_t >( layout_.cols ); }
+
+      std::size_t strings() const { return header_.strings; }
+
+      // String 'id', counting from 1, or NA for 0
+      span string( const std::uint32_t id ) const
+      {
+        if ( id == 0 ) {
+          return span();
+        }
+        const std::uint64_t * offsets = at< std::uint64_t >( layout_.string_offsets );
+        return span( file_.data() + layout_.string_bytes + offsets[ id - 1 ],
+                     offsets[ id ] - offsets[ id - 1 ] );
+      }
+
+    private:
+      mapped_file file_;
+      token_file_header header_;
+      token_file_layout layout_;
+
+      template< typename T >
+        const T * at( const std::uint64_t offset ) const
+        {
+          return reinterpret_cast< const T * >( file_.data() + offset );
+        }
+
+      static token_file_header check( const mapped_file & file, const std::string & path )
+      {
+        token_file_header h;
+        if ( file.size() < sizeof( h ) ) {
+          throw std::runtime_error( path + " isn't a token file" );
+        }
+        std::memcpy( &h, file.data(), sizeof( h ) );
+        if ( std::memcmp( h.magic, token_file_magic, sizeof( h.magic ) ) != 0 ) {
+          throw std::runtime_error( path + " isn't a token file" );
+        }
+        if ( h.version != token_file_version ) {
+          throw std::runtime_error( path + " is a token file of another version" );
+        }
+        if ( h.byte_order != token_file_byte_order ) {
+          throw std::runtime_error( path + " was written on a machine of another byte order" );
+        }
+        // Each is of at least a byte of the file, so the layout can't overflow
+        if ( h.formulas >= file.size() || h.tokens > file.size() || h.types > file.size()
+             || h.names > file.size() || h.strings >= file.size() || h.bytes > file.size() ) {
+          throw std::runtime_error( path + " is corrupt" );
+        }
+        return h;
+      }
+
+      // Offsets of n items, from 0 to 'end' without going back
+      static void check_offsets( const std::uint64_t * offsets, const std::uint64_t n,
+                                 const std::uint64_t end, const std::string & path )
+      {
+        for ( std::uint64_t i = 0; i < n; ++i ) {
+          if ( offsets[ i ] > offsets[ i + 1 ] ) {
+            throw std::runtime_error( path + " is corrupt" );
+          }
+        }
+        if ( offsets[ 0 ] != 0 || offsets[ n ] != end ) {
+          throw std::runtime_error( path + " is corrupt" );
+        }
+      }
+  };
+
+} // xltoken
+
+#endif
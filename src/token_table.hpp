@@ -0,0 +1,97 @@
+#ifndef XLTOKEN_TOKEN_TABLE_HPP
+#define XLTOKEN_TOKEN_TABLE_HPP
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "arena.hpp"
+#include "interner.hpp"
+
+namespace xltoken
+{
+
+  // Columns of tokens from a batch of formulas, one row per token.  The
+  // tokenize actions append to it.
+  //
+  // Tokens are spans of the formulas, so the formulas must outlive the table.
+  struct token_table
+  {
+    int formula;                     // id of the formula being parsed
+    const char * formula_begin;      // and its first character
+    std::size_t steps;               // rules it has started
+    std::size_t budget;              // of steps, or 0 for no limit
+    std::vector< int > formula_ids;
+    std::vector< std::string > types;
+    std::vector< span > tokens;
+    std::vector< int > starts;       // offset of each token in its formula
+    std::vector< span > values;      // decoded value, if any
+    std::vector< double > numbers;   // value of a number, otherwise NaN
+    std::vector< int > name_ids;     // id of a sheet/name/function, otherwise 0
+    arena strings;                   // backs values that aren't spans
+    interner names;                  // sheets, defined names, tables and UDFs
+
+    token_table() : formula( 0 ), formula_begin( nullptr ), steps( 0 ), budget( 0 ) {}
+
+    template< typename Input >
+      void push( const char * type, const Input & in, const span value = span() )
+      {
+        formula_ids.push_back( formula );
+        types.push_back( type );
+        tokens.push_back( span( in.begin(), in.size() ) );
+        starts.push_back( in.begin() - formula_begin );
+        values.push_back( value );
+        numbers.push_back( std::numeric_limits< double >::quiet_NaN() );
+        name_ids.push_back( 0 );
+      }
+
+    // Push a token that refers to something by name, e.g. a sheet
+    template< typename Input >
+      void push_name( const char * type, const Input & in, const span name,
+                      const span value = span() )
+      {
+        push( type, in, value );
+        name_ids.back() = names.intern( name );
+      }
+
+    // Push a row that stands for the whole of a formula, e.g. to say that it
+    // was abandoned
+    void push_status( const char * type, const span & formula )
+    {
+      formula_ids.push_back( this->formula );
+      types.push_back( type );
+      tokens.push_back( formula );
+      starts.push_back( 0 );
+      values.push_back( span() );
+      numbers.push_back( std::numeric_limits< double >::quiet_NaN() );
+      name_ids.push_back( 0 );
+    }
+
+    std::size_t size() const { return types.size(); }
+
+    void reserve( const std::size_t n )
+    {
+      formula_ids.reserve( n );
+      types.reserve( n );
+      tokens.reserve( n );
+      starts.reserve( n );
+      values.reserve( n );
+      numbers.reserve( n );
+      name_ids.reserve( n );
+    }
+
+    // Drop the tokens from row n on
+    void truncate( const std::size_t n )
+    {
+      formula_ids.resize( n );
+      types.resize( n );
+      tokens.resize( n );
+      starts.resize( n );
+      values.resize( n );
+      numbers.resize( n );
+      name_ids.resize( n );
+    }
+  };
+
+} // xltoken
+
+#endif
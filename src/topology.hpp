@@ -0,0 +1,206 @@
+#ifndef XLTOKEN_TOPOLOGY_HPP
+#define XLTOKEN_TOPOLOGY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace xltoken
+{
+
+  // Algorithms on directed graphs in compressed sparse row form: the targets
+  // of the edges from vertex v are targets[offsets[v]] up to
+  // targets[offsets[v + 1]], and vertices count from 0.
+
+  // Reverse the edges, e.g. to go from precedents to dependents
+  inline void transpose( const std::vector< int > & offsets,
+                         const std::vector< int > & targets,
+                         std::vector< int > & out_offsets,
+                         std::vector< int > & out_targets )
+  {
+    const std::size_t n = offsets.size() - 1;
+    out_offsets.assign( n + 1, 0 );
+    for ( std::size_t e = 0; e < targets.size(); ++e ) {
+      ++out_offsets[ targets[ e ] + 1 ];
+    }
+    for ( std::size_t v = 0; v < n; ++v ) {
+      out_offsets[ v + 1 ] += out_offsets[ v ];
+    }
+    std::vector< int > next( out_offsets.begin(), out_offsets.end() - 1 );
+    out_targets.resize( targets.size() );
+    for ( std::size_t v = 0; v < n; ++v ) {
+      for ( int e = offsets[ v ]; e < offsets[ v + 1 ]; ++e ) {
+        out_targets[ next[ targets[ e ] ]++ ] = v;
+      }
+    }
+  }
+
+  // Tarjan's strongly connected components, iteratively so that long chains
+  // don't overflow the stack.  Only vertices where 'within' is true are
+  // visited, and edges to other vertices are ignored.
+  //
+  // Returns the number of cycles, i.e. components with more than one vertex,
+  // or one vertex with an edge to itself.  The vertices of the i-th cycle get
+  // the id i in 'cycles', counting from 1, and every other vertex gets 0.
+  inline int find_cycles( const std::vector< int > & offsets,
+                          const std::vector< int > & targets,
+                          const std::vector< bool > & within,
+                          std::vector< int > & cycles )
+  {
+    const int n = offsets.size() - 1;
+    cycles.assign( n, 0 );
+    std::vector< int > index( n, -1 ), low( n, 0 ), next( n, 0 );
+    std::vector< bool > on_stack( n, false );
+    std::vector< int > stack, call;
+    int counter = 0;
+    int found = 0;
+    for ( int start = 0; start < n; ++start ) {
+      if ( !within[ start ] || index[ start ] != -1 ) {
+        continue;
+      }
+      call.push_back( start );
+      while ( !call.empty() ) {
+        const int v = call.back();
+        if ( index[ v ] == -1 ) {
+          index[ v ] = low[ v ] = counter++;
+          next[ v ] = offsets[ v ];
+          stack.push_back( v );
+          on_stack[ v ] = true;
+        }
+        if ( next[ v ] < offsets[ v + 1 ] ) {
+          const int w = targets[ next[ v ]++ ];
+          if ( !within[ w ] ) {
+            continue;
+          }
+          if ( index[ w ] == -1 ) {
+            call.push_back( w );
+          } else if ( on_stack[ w ] ) {
+            low[ v ] = std::min( low[ v ], index[ w ] );
+          }
+          continue;
+        }
+        call.pop_back();
+        if ( !call.empty() ) {
+          low[ call.back() ] = std::min( low[ call.back() ], low[ v ] );
+        }
+        if ( low[ v ] != index[ v ] ) {
+          continue;
+        }
+        // v is the root of a component, which is on the stack above it
+        const std::size_t top = std::find( stack.rbegin(), stack.rend(), v ).base() - 1
+                                - stack.begin();
+        bool cycle = stack.size() - top > 1;
+        for ( int e = offsets[ v ]; !cycle && e < offsets[ v + 1 ]; ++e ) {
+          cycle = targets[ e ] == v;
+        }
+        if ( cycle ) {
+          ++found;
+        }
+        for ( std::size_t k = top; k < stack.size(); ++k ) {
+          on_stack[ stack[ k ] ] = false;
+          if ( cycle ) {
+            cycles[ stack[ k ] ] = found;
+          }
+        }
+        stack.resize( top );
+      }
+    }
+    return found;
+  }
+
+  // Kahn's algorithm, a level at a time.  Level 0 is the vertices without
+  // precedents, and level L + 1 is the vertices whose precedents are all in
+  // levels up to L, so the vertices of a level are independent of one
+  // another and can be recalculated in parallel.
+  //
+  // 'offsets' and 'precedents' are the edges from each vertex to its
+  // precedents.  Vertices in cycles, or that depend on them, never become
+  // free, and get the level -1.  Returns the number of levels.
+  //
+  // Levels are relaxed by 'threads' threads at once when they're big enough
+  // to be worth it.  A long chain of small levels is done serially.
+  inline int schedule_levels( const std::vector< int > & offsets,
+                              const std::vector< int > & precedents,
+                              const unsigned threads,
+                              std::vector< int > & levels )
+  {
+    const int n = offsets.size() - 1;
+    std::vector< int > dependent_offsets, dependents;
+    transpose( offsets, precedents, dependent_offsets, dependents );
+
+    std::vector< std::atomic< int > > waiting( n );
+    std::vector< int > frontier;
+    for ( int v = 0; v < n; ++v ) {
+      waiting[ v ].store( offsets[ v + 1 ] - offsets[ v ], std::memory_order_relaxed );
+      if ( offsets[ v + 1 ] == offsets[ v ] ) {
+        frontier.push_back( v );
+      }
+    }
+
+    // Free the dependents of frontier[first, last), appending them to 'out'
+    struct relax
+    {
+      static void range( const std::vector< int > & frontier,
+                         const std::size_t first,
+                         const std::size_t last,
+                         const std::vector< int > & dependent_offsets,
+                         const std::vector< int > & dependents,
+                         std::vector< std::atomic< int > > & waiting,
+                         std::vector< int > & out )
+      {
+        for ( std::size_t i = first; i < last; ++i ) {
+          const int v = frontier[ i ];
+          for ( int e = dependent_offsets[ v ]; e < dependent_offsets[ v + 1 ]; ++e ) {
+            const int w = dependents[ e ];
+            if ( waiting[ w ].fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) {
+              out.push_back( w );
+            }
+          }
+        }
+      }
+    };
+
+    const std::size_t parallel_threshold = 16384;
+    levels.assign( n, -1 );
+    std::vector< int > next;
+    std::vector< std::vector< int > > local( std::max( threads, 1u ) );
+    int level = 0;
+    while ( !frontier.empty() ) {
+      for ( std::size_t i = 0; i < frontier.size(); ++i ) {
+        levels[ frontier[ i ] ] = level;
+      }
+      next.clear();
+      if ( threads <= 1 || frontier.size() < parallel_threshold ) {
+        relax::range( frontier, 0, frontier.size(),
+                      dependent_offsets, dependents, waiting, next );
+      } else {
+        const std::size_t chunk = ( frontier.size() + threads - 1 ) / threads;
+        std::vector< std::thread > workers;
+        for ( unsigned t = 0; t < threads; ++t ) {
+          local[ t ].clear();
+          const std::size_t first = std::min( frontier.size(), t * chunk );
+          const std::size_t last = std::min( frontier.size(), first + chunk );
+          workers.push_back( std::thread( relax::range,
+                                          std::cref( frontier ), first, last,
+                                          std::cref( dependent_offsets ),
+                                          std::cref( dependents ),
+                                          std::ref( waiting ),
+                                          std::ref( local[ t ] ) ) );
+        }
+        for ( unsigned t = 0; t < threads; ++t ) {
+          workers[ t ].join();
+          next.insert( next.end(), local[ t ].begin(), local[ t ].end() );
+        }
+      }
+      frontier.swap( next );
+      ++level;
+    }
+    return level;
+  }
+
+} // xltoken
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef XLTOKEN_WRAP_HPP
+#define XLTOKEN_WRAP_HPP
+
+#include <Rcpp.h>
+#include <Rversion.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "token_table.hpp"
+#include "names.hpp"
+
+// Conversion between the native token table and R
+
+// Tokens and decoded values are spans of the input or of the batch's arena,
+// so they're only copied once, into R's string cache.
+inline Rcpp::CharacterVector wrap_spans(const std::vector<xltoken::span> & spans)
+{
+  int n = spans.size();
+  Rcpp::CharacterVector out(n);
+  for (int i = 0; i < n; ++i) {
+    const xltoken::span & value = spans[i];
+    if (value.is_na()) {
+      out[i] = NA_STRING;
+    } else {
+      out[i] = Rf_mkCharLenCE(value.data, value.size, CE_UTF8);
+    }
+  }
+  return out;
+}
+
+// Ids count from 1, with 0 for none
+inline Rcpp::IntegerVector wrap_ids(const std::vector<int> & ids)
+{
+  int n = ids.size();
+  Rcpp::IntegerVector out(n);
+  for (int i = 0; i < n; ++i) {
+    out[i] = ids[i] == 0 ? NA_INTEGER : ids[i];
+  }
+  return out;
+}
+
+// Interned names become a factor: the ids are the codes, and the dictionary
+// is the levels, so it's only returned once.
+inline Rcpp::IntegerVector wrap_names(const std::vector<int> & ids,
+                                      const xltoken::interner & names)
+{
+  Rcpp::IntegerVector out = wrap_ids(ids);
+  out.attr("levels") = wrap_spans(names.strings());
+  out.attr("class") = "factor";
+  return out;
+}
+
+// Numbers are NaN where there isn't one, which R must be told is NA.
+inline Rcpp::NumericVector wrap_numbers(const std::vector<double> & numbers)
+{
+  int n = numbers.size();
+  Rcpp::NumericVector out(n);
+  for (int i = 0; i < n; ++i) {
+    out[i] = numbers[i] != numbers[i] ? NA_REAL : numbers[i];
+  }
+  return out;
+}
+
+// Make every string of an ALTREP character vector, such as the lazy columns
+// of xl_formula(), so that the vector keeps them.  Otherwise each element is
+// made when it's asked for, protected by nothing, and can be collected while
+// pointers to it are kept.
+inline void materialize_strings(SEXP x)
+{
+#if R_VERSION >= R_Version(3, 6, 0)
+  if (ALTREP(x)) {
+    STRING_PTR_RO(x);
+  }
+#endif
+}
+
+// Elements of a character vector as spans of R's own strings, which R keeps
+// alive for the duration of the call.  NA becomes an NA span.
+inline std::vector<xltoken::span> as_spans(Rcpp::CharacterVector x)
+{
+  materialize_strings(x);
+  int n = x.size();
+  std::vector<xltoken::span> out(n);
+  for (int i = 0; i < n; ++i) {
+    SEXP s = STRING_ELT(x, i);
+    if (s != NA_STRING) {
+      out[i] = xltoken::span(CHAR(s), LENGTH(s));
+    }
+  }
+  return out;
+}
+
+// Threads to use, where less than 1 means one per core
+inline unsigned as_threads(int threads)
+{
+  return threads < 1 ? std::max(1u, std::thread::hardware_concurrency()) : threads;
+}
+
+// Make a list of equal-length columns into a tibble
+inline void as_tibble(Rcpp::List & out, int n)
+{
+  out.attr("class") = Rcpp::CharacterVector::create("tbl_df", "tbl", "data.frame");
+  out.attr("row.names") = Rcpp::IntegerVector::create(NA_INTEGER, -n); // Dunno how this works (the -n part)
+}
+
+// Defined names from parallel vectors, where an NA or empty sheet means the
+// name is global
+inline xltoken::name_table as_name_table(Rcpp::CharacterVector name,
+                                         Rcpp::CharacterVector name_sheet,
+                                         Rcpp::CharacterVector name_formula)
+{
+  xltoken::name_table names;
+  for (int i = 0; i < name.size(); ++i) {
+    std::string sheet;
+    if (STRING_ELT(name_sheet, i) != NA_STRING) {
+      sheet = Rcpp::as< std::string >(name_sheet[i]);
+    }
+    names.add(Rcpp::as< std::string >(name[i]),
+              sheet,
+              Rcpp::as< std::string >(name_formula[i]));
+  }
+  names.parse();
+  return names;
+}
+
+#endif
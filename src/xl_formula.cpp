@@ -1,12 +1,70 @@
 #include <Rcpp.h>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <string>
 #include "tao/pegtl/contrib/tracer.hpp"
 #include "tao/pegtl/analyze.hpp"
 #include "xltoken.hpp"
+#include "names.hpp"
+#include "edit.hpp"
+#include "token_file.hpp"
+#include "arrow_ipc.hpp"
+#include "parse_cache.hpp"
+#include "lru_cache.hpp"
+#include "formula_stream.hpp"
+#include "pipeline.hpp"
+#include "heatmap.hpp"
+#include "generator.hpp"
+#include "wrap.hpp"
+#include "lazy_strings.hpp"
 
+// [[Rcpp::init]]
+void xl_init_(DllInfo * dll)
+{
+  init_lazy_strings(dll);
+}
+
+// The grammar's issues, as PEGTL's analysis finds them, and where it
+// backtracks when it parses the formulas of a corpus, one row per rule
 // [[Rcpp::export]]
-void xl_check_grammar_()
+Rcpp::List xl_check_grammar_(Rcpp::CharacterVector corpus)
 {
   const size_t issues_found = tao::pegtl::analyze< xltoken::root >();
+
+  std::vector<xltoken::rule_heat> heat;
+  std::size_t abandoned;
+  xltoken::grammar_heatmap(as_spans(corpus), heat, abandoned);
+
+  int n = heat.size();
+  Rcpp::CharacterVector rule(n);
+  Rcpp::NumericVector starts(n), successes(n), failures(n), discarded(n), ratio(n);
+  Rcpp::IntegerVector formula(n), position(n);
+  for (int i = 0; i < n; ++i) {
+    const xltoken::rule_heat & h = heat[i];
+    rule[i] = h.rule;
+    starts[i] = h.starts;
+    successes[i] = h.successes;
+    failures[i] = h.failures;
+    discarded[i] = h.discarded;
+    ratio[i] = h.worst_ratio;
+    formula[i] = h.worst_formula == 0 ? NA_INTEGER : h.worst_formula;
+    position[i] = h.worst_formula == 0 ? NA_INTEGER : static_cast<int>(h.worst_position) + 1;
+  }
+  Rcpp::List out = Rcpp::List::create(
+      Rcpp::_["rule"] = rule,
+      Rcpp::_["starts"] = starts,
+      Rcpp::_["successes"] = successes,
+      Rcpp::_["failures"] = failures,
+      Rcpp::_["discarded"] = discarded,
+      Rcpp::_["worst_ratio"] = ratio,
+      Rcpp::_["worst_formula"] = formula,
+      Rcpp::_["worst_position"] = position
+      );
+  as_tibble(out, n);
+  out.attr("issues") = static_cast<int>(issues_found);
+  out.attr("abandoned") = static_cast<double>(abandoned);
+  return out;
 }
 
 /* // [[Rcpp::export]] */
@@ -39,31 +97,512 @@ void xl_check_grammar_()
 /*   /1* Rcpp::Rcout << "Formula is: " << formula_tokens << "\n"; *1/ */
 /* } */
 
+// The columns of xl_formula(), where definitions are the defined names that
+// NAME tokens resolve to.  If the tokens are spans of the strings of
+// 'formulas', rather than R_NilValue, the token and value columns are lazy,
+// and take the table's spans and arena.
+static Rcpp::List wrap_tokens(xltoken::token_table & table,
+                              const std::vector<int> & definitions,
+                              SEXP formulas = R_NilValue)
+{
+  int n = table.size();
+  Rcpp::IntegerVector start(n);
+  for (int i = 0; i < n; ++i) {
+    start[i] = table.starts[i] + 1;
+  }
+
+  Rcpp::CharacterVector token, value;
+  if (formulas != R_NilValue) {
+    wrap_lazy_tokens(table, formulas, token, value);
+  } else {
+    token = wrap_spans(table.tokens);
+    value = wrap_spans(table.values);
+  }
+
+  Rcpp::List out = Rcpp::List::create(
+      Rcpp::_["formula_id"] = table.formula_ids,
+      Rcpp::_["type"] = table.types,
+      Rcpp::_["token"] = token,
+      Rcpp::_["start"] = start,
+      Rcpp::_["value"] = value,
+      Rcpp::_["number"] = wrap_numbers(table.numbers),
+      Rcpp::_["name"] = wrap_names(table.name_ids, table.names),
+      Rcpp::_["definition"] = wrap_ids(definitions)
+      );
+  as_tibble(out, n);
+  return out;
+}
+
+// The columns of xl_formula() back into a table.  Tokens are spans of the
+// formula 'text' if given, which they must lie within, otherwise of R's
+// strings of the tokens, which R keeps alive for the duration of the call.
+static void as_token_table(Rcpp::List tokens,
+                           const xltoken::span & text,
+                           xltoken::token_table & table)
+{
+  Rcpp::IntegerVector formula_id = tokens["formula_id"];
+  Rcpp::CharacterVector type = tokens["type"];
+  Rcpp::CharacterVector token = tokens["token"];
+  Rcpp::IntegerVector start = tokens["start"];
+  Rcpp::CharacterVector value = tokens["value"];
+  Rcpp::NumericVector number = tokens["number"];
+  Rcpp::IntegerVector name_id = tokens["name"];
+  Rcpp::CharacterVector levels = name_id.attr("levels");
+  const int n = type.size();
+  if (formula_id.size() != n || token.size() != n || start.size() != n
+      || value.size() != n || number.size() != n || name_id.size() != n) {
+    Rcpp::stop("The columns of the tokens must be the same length");
+  }
+  materialize_strings(token);
+  std::vector<xltoken::span> values = as_spans(value);
+  std::vector<xltoken::span> level_spans = as_spans(levels);
+  table.reserve(n);
+  for (int i = 0; i < n; ++i) {
+    SEXP s = STRING_ELT(token, i);
+    if (!text.is_na()
+        && (s == NA_STRING || start[i] == NA_INTEGER || start[i] < 1
+            || static_cast<std::size_t>(start[i] - 1) + LENGTH(s) > text.size)) {
+      Rcpp::stop("The tokens must be of the formula");
+    }
+    table.formula_ids.push_back(formula_id[i]);
+    table.types.push_back(Rcpp::as< std::string >(type[i]));
+    table.tokens.push_back(xltoken::span(!text.is_na() ? text.data + start[i] - 1 : CHAR(s),
+                                         LENGTH(s)));
+    table.starts.push_back(start[i] - 1);
+    table.values.push_back(values[i]);
+    table.numbers.push_back(Rcpp::NumericVector::is_na(number[i])
+                            ? std::numeric_limits<double>::quiet_NaN()
+                            : number[i]);
+    if (name_id[i] != NA_INTEGER
+        && (name_id[i] < 1 || name_id[i] > static_cast<int>(level_spans.size()))) {
+      Rcpp::stop("The names of the tokens must be among their levels");
+    }
+    table.name_ids.push_back(name_id[i] == NA_INTEGER
+                             ? 0
+                             : table.names.intern(level_spans[name_id[i] - 1]));
+  }
+}
 
 // [[Rcpp::export]]
-Rcpp::List xl_formula_(Rcpp::CharacterVector x)
+Rcpp::List xl_formula_(Rcpp::CharacterVector x,
+                       Rcpp::CharacterVector sheet,
+                       Rcpp::CharacterVector name,
+                       Rcpp::CharacterVector name_sheet,
+                       Rcpp::CharacterVector name_formula,
+                       Rcpp::CharacterVector cache)
 {
 
-  std::string in_string;             // the formula from the iterator
   Rcpp::List out;               // wraps the vectors below
-  std::vector<std::string> types;
-  std::vector<std::string> tokens;
+  xltoken::token_table table;   // columns of tokens, and the batch's arena
+
+  // Formulas that are in the session's cache or the one on disk aren't
+  // parsed, and those that aren't are added to them
+  xltoken::token_lru & session = xltoken::session_tokens();
+  std::unique_ptr<xltoken::parse_cache> cached;
+  if (cache.size() > 0 && STRING_ELT(cache, 0) != NA_STRING) {
+    cached.reset(new xltoken::parse_cache(Rcpp::as< std::string >(cache[0])));
+  }
+
+  // Parse the formulas in place, so that the decoded values can be spans of
+  // them.  R keeps x alive until we return.
+  for (int i = 0; i < x.size(); ++i) {
+    table.formula = i + 1;
+    SEXP formula = STRING_ELT(x, i);
+    if (formula == NA_STRING) {
+      continue;
+    }
+    const xltoken::span text(CHAR(formula), LENGTH(formula));
+    if (session.lookup(text, table)) {
+      xltoken::fast_path().count_cached();
+      continue;
+    }
+    std::size_t first = table.size();
+    if (cached && cached->lookup(text, table)) {
+      xltoken::fast_path().count_cached();
+    } else {
+      // A malformed formula keeps the tokens before the error, as in the
+      // pipeline, but isn't cached
+      try {
+        if (!xltoken::parse_formula( text.data, text.size, table )) {
+          continue;
+        }
+      } catch (const tao::pegtl::parse_error &) {
+        continue;
+      }
+      if (cached) {
+        cached->add(text, table, first, table.size());
+      }
+    }
+    session.add(text, table, first, table.size());
+  }
+  if (cached) {
+    cached->commit();
+  }
+
+  // Every NAME token, resolved to the row of its definition
+  std::vector<int> definitions;
+  as_name_table(name, name_sheet, name_formula)
+    .resolve(table, as_spans(sheet), definitions);
+
+  out = wrap_tokens(table, definitions, x);
+
+  return out;
+}
+
+// [[Rcpp::export]]
+Rcpp::List xl_edit_(Rcpp::CharacterVector x,
+                    Rcpp::List tokens,
+                    int at,
+                    int deleted,
+                    Rcpp::CharacterVector inserted,
+                    Rcpp::CharacterVector sheet,
+                    Rcpp::CharacterVector name,
+                    Rcpp::CharacterVector name_sheet,
+                    Rcpp::CharacterVector name_formula)
+{
+  if (x.size() != 1 || inserted.size() != 1) {
+    Rcpp::stop("The formula and the inserted text must be single strings");
+  }
+  SEXP formula = STRING_ELT(x, 0);
+  SEXP insert = STRING_ELT(inserted, 0);
+  if (formula == NA_STRING || insert == NA_STRING) {
+    Rcpp::stop("The formula and the inserted text must not be NA");
+  }
+  const xltoken::span text(CHAR(formula), LENGTH(formula));
+  if (at < 1 || deleted < 0
+      || static_cast<std::size_t>(at - 1) + static_cast<std::size_t>(deleted) > text.size) {
+    Rcpp::stop("The edit must be within the formula");
+  }
+
+  // The tokens before the edit, back into a table, as spans of the formula
+  xltoken::token_table before;
+  before.formula_begin = text.data;
+  as_token_table(tokens, text, before);
+  Rcpp::IntegerVector formula_id = tokens["formula_id"];
+
+  std::string edited;
+  xltoken::token_table table;
+  table.formula = 1;
+  xltoken::edit change;
+  change.offset = at - 1;
+  change.deleted = deleted;
+  change.inserted = xltoken::span(CHAR(insert), LENGTH(insert));
+  xltoken::parse_edit(text, before, change, edited, table);
+
+  std::vector<int> definitions;
+  as_name_table(name, name_sheet, name_formula)
+    .resolve(table, as_spans(sheet), definitions);
+  if (formula_id.size() > 0) {
+    std::fill(table.formula_ids.begin(), table.formula_ids.end(), formula_id[0]);
+  }
+
+  return Rcpp::List::create(
+      Rcpp::_["formula"] = Rcpp::String(edited, CE_UTF8),
+      Rcpp::_["tokens"] = wrap_tokens(table, definitions)
+      );
+}
+
+// [[Rcpp::export]]
+void xl_tokens_write_(Rcpp::List tokens, std::string path)
+{
+  xltoken::token_table table;
+  as_token_table(tokens, xltoken::span(), table);
+  Rcpp::IntegerVector definition = tokens["definition"];
+  std::vector<int> definitions(definition.size());
+  for (int i = 0; i < definition.size(); ++i) {
+    definitions[i] = definition[i] == NA_INTEGER ? 0 : definition[i];
+  }
+  xltoken::write_token_file(path, table, definitions);
+}
+
+// [[Rcpp::export]]
+Rcpp::List xl_tokens_read_(std::string path)
+{
+  const xltoken::token_file file(path);
+  int n = file.size();
+
+  // Each string becomes an R string once, however many tokens it's in
+  int m = file.strings();
+  Rcpp::CharacterVector strings(m);
+  for (int s = 0; s < m; ++s) {
+    const xltoken::span string = file.string(s + 1);
+    SET_STRING_ELT(strings, s, Rf_mkCharLenCE(string.data, string.size, CE_UTF8));
+  }
+  auto string_elt = [&](std::uint32_t id) {
+    if (id > static_cast<std::uint32_t>(m)) {
+      Rcpp::stop("%s is corrupt", path);
+    }
+    return id == 0 ? NA_STRING : STRING_ELT(strings, id - 1);
+  };
+
+  Rcpp::IntegerVector formula_id(n);
+  // The file has checked that these run from 0 to n
+  const std::uint64_t * offsets = file.formula_offsets();
+  for (std::size_t f = 0; f < file.formulas(); ++f) {
+    for (std::uint64_t i = offsets[f]; i < offsets[f + 1]; ++i) {
+      formula_id[i] = f + 1;
+    }
+  }
+
+  int types = file.header().types;
+  Rcpp::CharacterVector type_strings(types);
+  for (int t = 0; t < types; ++t) {
+    SET_STRING_ELT(type_strings, t, string_elt(file.type_ids()[t]));
+  }
+  Rcpp::CharacterVector type(n), token(n), value(n);
+  Rcpp::IntegerVector start(n), name(n), definition(n);
+  Rcpp::NumericVector number(n);
+  int names = file.header().names;
+  for (int i = 0; i < n; ++i) {
+    if (file.type_codes()[i] >= types || file.name_codes()[i] > names) {
+      Rcpp::stop("%s is corrupt", path);
+    }
+    SET_STRING_ELT(type, i, STRING_ELT(type_strings, file.type_codes()[i]));
+    SET_STRING_ELT(token, i, string_elt(file.token_ids()[i]));
+    SET_STRING_ELT(value, i, string_elt(file.value_ids()[i]));
+    start[i] = file.starts()[i] + 1;
+    const double x = file.numbers()[i];
+    number[i] = x != x ? NA_REAL : x;
+    name[i] = file.name_codes()[i] == 0 ? NA_INTEGER : file.name_codes()[i];
+    definition[i] = file.definitions()[i] == 0 ? NA_INTEGER : file.definitions()[i];
+  }
+  Rcpp::CharacterVector levels(names);
+  for (int d = 0; d < names; ++d) {
+    SET_STRING_ELT(levels, d, string_elt(file.name_ids()[d]));
+  }
+  name.attr("levels") = levels;
+  name.attr("class") = "factor";
 
-    in_string = Rcpp::as< std::string >(x);
+  Rcpp::List out = Rcpp::List::create(
+      Rcpp::_["formula_id"] = formula_id,
+      Rcpp::_["type"] = type,
+      Rcpp::_["token"] = token,
+      Rcpp::_["start"] = start,
+      Rcpp::_["value"] = value,
+      Rcpp::_["number"] = number,
+      Rcpp::_["name"] = name,
+      Rcpp::_["definition"] = definition
+      );
+  as_tibble(out, n);
+  return out;
+}
+
+// Tokenize formulas 'batch' at a time, writing each batch's tokens as a
+// record batch and then forgetting them
+template <typename Sink>
+static void write_arrow(Rcpp::CharacterVector x, int batch, Sink & sink)
+{
+  xltoken::arrow_token_writer<Sink> writer(sink);
+  int n = x.size();
+  for (int first = 0; first < n; first += batch) {
+    xltoken::token_table table;
+    for (int i = first; i < std::min(n, first + batch); ++i) {
+      table.formula = i + 1;
+      SEXP formula = STRING_ELT(x, i);
+      if (formula == NA_STRING) {
+        continue;
+      }
+      // A malformed formula keeps the tokens before the error, as in the
+      // pipeline
+      try {
+        xltoken::parse_formula( CHAR(formula), LENGTH(formula), table );
+      } catch (const tao::pegtl::parse_error &) {
+      }
+    }
+    writer.write(table);
+  }
+  writer.close();
+}
 
-    memory_input<> in_mem( in_string, "original-formula" );
-    /* parse< xltoken::root, xltoken::tokenize >( in_mem, types, tokens); */
-    parse< xltoken::root, xltoken::tokenize, tracer >( in_mem, types, tokens);
+// [[Rcpp::export]]
+SEXP xl_formula_arrow_(Rcpp::CharacterVector x,
+                       Rcpp::CharacterVector path,
+                       int batch)
+{
+  if (batch < 1) {
+    Rcpp::stop("The batch size must be at least 1");
+  }
+  if (path.size() == 0 || STRING_ELT(path, 0) == NA_STRING) {
+    xltoken::buffer_sink sink;
+    write_arrow(x, batch, sink);
+    Rcpp::RawVector out(sink.bytes.size());
+    std::copy(sink.bytes.begin(), sink.bytes.end(), out.begin());
+    return out;
+  }
+  xltoken::file_sink sink(Rcpp::as< std::string >(path[0]));
+  write_arrow(x, batch, sink);
+  return R_NilValue;
+}
+
+// [[Rcpp::export]]
+SEXP xl_formula_stream_(std::string path, double chunk)
+{
+  if (!(chunk >= 1)) {
+    Rcpp::stop("The chunk size must be at least 1 byte");
+  }
+  Rcpp::XPtr<xltoken::formula_stream> stream(
+      new xltoken::formula_stream(path, chunk), true);
+  stream.attr("class") = "xl_formula_stream";
+  return stream;
+}
 
-    out = Rcpp::List::create(
-        Rcpp::_["type"] = types,
-        Rcpp::_["token"] = tokens
-        );
+// [[Rcpp::export]]
+SEXP xl_formula_next_(SEXP stream)
+{
+  Rcpp::XPtr<xltoken::formula_stream> formulas(stream);
+  xltoken::token_table table;
+  if (!formulas->next(table)) {
+    return R_NilValue;
+  }
+  // The tokens are spans of the stream's buffer, so are copied now, and
+  // names aren't resolved
+  std::vector<int> definitions(table.size(), 0);
+  return wrap_tokens(table, definitions);
+}
 
-    int n = tokens.size();
-    out.attr("class") = Rcpp::CharacterVector::create("tbl_df", "tbl", "data.frame");
-    out.attr("row.names") = Rcpp::IntegerVector::create(NA_INTEGER, -n); // Dunno how this works (the -n part)
+// [[Rcpp::export]]
+Rcpp::List xl_formula_pipeline_(std::string input,
+                                std::string output,
+                                int threads,
+                                int batch)
+{
+  if (batch < 1) {
+    Rcpp::stop("The batch size must be at least 1");
+  }
+  const xltoken::mapped_file in(input);
+  xltoken::file_sink sink(output);
+  xltoken::arrow_token_writer<xltoken::file_sink> writer(sink);
+  xltoken::pipeline_stats stats =
+    xltoken::tokenize_pipeline(in.data(), in.data() + in.size(), writer,
+                               as_threads(threads), batch);
+  writer.close();
+  return Rcpp::List::create(
+      Rcpp::_["formulas"] = static_cast<double>(stats.formulas),
+      Rcpp::_["tokens"] = static_cast<double>(stats.tokens),
+      Rcpp::_["seconds"] = stats.seconds,
+      Rcpp::_["reader"] = stats.reader,
+      Rcpp::_["parsers"] = stats.parsers,
+      Rcpp::_["writer"] = stats.writer
+      );
+}
 
+// [[Rcpp::export]]
+Rcpp::List xl_formula_cache_(double size, bool clear)
+{
+  xltoken::token_lru & session = xltoken::session_tokens();
+  if (clear) {
+    session.clear();
+  }
+  if (!Rcpp::NumericVector::is_na(size)) {
+    if (size < 0) {
+      Rcpp::stop("The size of the cache can't be negative");
+    }
+    if (!R_finite(size)
+        || size >= static_cast<double>(std::numeric_limits<std::size_t>::max())) {
+      Rcpp::stop("The size of the cache is too big");
+    }
+    session.resize(size);
+  }
+  xltoken::token_lru::stats s = session.statistics();
+  return Rcpp::List::create(
+      Rcpp::_["size"] = static_cast<double>(s.capacity),
+      Rcpp::_["used"] = static_cast<double>(s.used),
+      Rcpp::_["entries"] = static_cast<double>(s.entries),
+      Rcpp::_["hits"] = static_cast<double>(s.hits),
+      Rcpp::_["misses"] = static_cast<double>(s.misses),
+      Rcpp::_["evictions"] = static_cast<double>(s.evictions)
+      );
+}
+
+// [[Rcpp::export]]
+Rcpp::List xl_formula_budget_(double steps)
+{
+  xltoken::parse_budget & budget = xltoken::formula_budget();
+  if (!Rcpp::NumericVector::is_na(steps)) {
+    if (steps < 0) {
+      Rcpp::stop("The budget can't be negative");
+    }
+    // SIZE_MAX rounds up to a power of 2 as a double, which doesn't fit
+    if (!R_finite(steps)
+        || steps >= static_cast<double>(std::numeric_limits<std::size_t>::max())) {
+      Rcpp::stop("The budget is too big; 0 is no limit");
+    }
+    budget.steps = steps;
+  }
+  return Rcpp::List::create(
+      Rcpp::_["steps"] = static_cast<double>(budget.steps.load()),
+      Rcpp::_["exceeded"] = static_cast<double>(budget.exceeded.load())
+      );
+}
+
+// [[Rcpp::export]]
+Rcpp::List xl_formula_fast_path_(bool reset)
+{
+  xltoken::fast_path_counts & counts = xltoken::fast_path();
+  const double formulas = counts.formulas();
+  const double hits = counts.hits();
+  const double cached = counts.cached();
+  if (reset) {
+    counts.reset();
+  }
+  return Rcpp::List::create(
+      Rcpp::_["formulas"] = formulas,
+      Rcpp::_["hits"] = hits,
+      Rcpp::_["cached"] = cached,
+      Rcpp::_["rate"] = formulas > 0 ? hits / formulas : NA_REAL
+      );
+}
+
+// [[Rcpp::export]]
+Rcpp::CharacterVector xl_formula_corpus_(int n,
+                                         double seed,
+                                         int depth,
+                                         double functions,
+                                         double references,
+                                         int string_length,
+                                         double sheets)
+{
+  if (n < 0 || depth < 0 || string_length < 0) {
+    Rcpp::stop("The number, depth and string length can't be negative");
+  }
+  xltoken::corpus_shape shape;
+  shape.depth = depth;
+  shape.functions = functions;
+  shape.references = references;
+  shape.string_length = string_length;
+  shape.sheets = sheets;
+  xltoken::formula_generator generator(shape, static_cast<std::uint64_t>(seed));
+  Rcpp::CharacterVector out(n);
+  for (int i = 0; i < n; ++i) {
+    const std::string formula = generator.next();
+    out[i] = Rf_mkCharLenCE(formula.data(), formula.size(), CE_UTF8);
+  }
   return out;
 }
 
+// [[Rcpp::export]]
+Rcpp::List xl_names_(Rcpp::CharacterVector name,
+                     Rcpp::CharacterVector name_sheet,
+                     Rcpp::CharacterVector name_formula)
+{
+  xltoken::name_table names = as_name_table(name, name_sheet, name_formula);
+
+  int n = names.size();
+  Rcpp::LogicalVector circular(n);
+  Rcpp::List refers_to(n);
+  for (int d = 1; d <= n; ++d) {
+    circular[d - 1] = names.circular(d);
+    refers_to[d - 1] = Rcpp::wrap(names.closure(d));
+  }
+
+  Rcpp::List out = Rcpp::List::create(
+      Rcpp::_["name"] = name,
+      Rcpp::_["sheet"] = name_sheet,
+      Rcpp::_["formula"] = name_formula,
+      Rcpp::_["circular"] = circular,
+      Rcpp::_["refers_to"] = refers_to
+      );
+  as_tibble(out, n);
+
+  return out;
+}
@@ -0,0 +1,132 @@
+#include <Rcpp.h>
+#include "graph.hpp"
+#include "topology.hpp"
+#include "wrap.hpp"
+
+// [[Rcpp::export]]
+Rcpp::List xl_graph_(Rcpp::CharacterVector sheet,
+                     Rcpp::IntegerVector row,
+                     Rcpp::IntegerVector col,
+                     Rcpp::CharacterVector formula,
+                     Rcpp::CharacterVector name,
+                     Rcpp::CharacterVector name_sheet,
+                     Rcpp::CharacterVector name_formula)
+{
+  if (sheet.size() != formula.size() || row.size() != formula.size()
+      || col.size() != formula.size()) {
+    Rcpp::stop("The sheets, rows, columns and formulas must be the same length");
+  }
+  xltoken::name_table names = as_name_table(name, name_sheet, name_formula);
+
+  // Formulas are tokenized in place, so they're spans of R's strings
+  std::vector<xltoken::span> sheets = as_spans(sheet);
+  std::vector<xltoken::span> formulas = as_spans(formula);
+  xltoken::dependency_graph graph;
+  for (int i = 0; i < formula.size(); ++i) {
+    graph.add(sheets[i], row[i], col[i], formulas[i]);
+  }
+  graph.build(names);
+
+  // One row per vertex: formula cells, then areas
+  int n = graph.vertices();
+  Rcpp::CharacterVector type(n);
+  Rcpp::LogicalVector has_formula(n);
+  Rcpp::IntegerVector vertex_sheet(n), first_row(n), first_col(n), last_row(n), last_col(n);
+  for (int v = 0; v < n; ++v) {
+    has_formula[v] = v < graph.cells();
+    if (v < graph.cells()) {
+      type[v] = "cell";
+      vertex_sheet[v] = graph.sheet(v);
+      first_row[v] = last_row[v] = graph.row(v);
+      first_col[v] = last_col[v] = graph.col(v);
+    } else {
+      const xltoken::area & a = graph.areas()[v - graph.cells()];
+      type[v] = a.is_cell() ? "cell" : "range";
+      vertex_sheet[v] = a.sheet > 0 ? a.sheet : NA_INTEGER; // NA if external
+      first_row[v] = a.first_row;
+      first_col[v] = a.first_col;
+      last_row[v] = a.last_row;
+      last_col[v] = a.last_col;
+    }
+  }
+  vertex_sheet.attr("levels") = wrap_spans(graph.sheets().strings());
+  vertex_sheet.attr("class") = "factor";
+
+  Rcpp::List vertices = Rcpp::List::create(
+      Rcpp::_["type"] = type,
+      Rcpp::_["formula"] = has_formula,
+      Rcpp::_["sheet"] = vertex_sheet,
+      Rcpp::_["first_row"] = first_row,
+      Rcpp::_["first_col"] = first_col,
+      Rcpp::_["last_row"] = last_row,
+      Rcpp::_["last_col"] = last_col
+      );
+  as_tibble(vertices, n);
+
+  // Precedents count vertices from 1, as R does, but offsets are from 0, so
+  // the precedents of vertex v are precedents[(offsets[v] + 1):offsets[v + 1]]
+  Rcpp::IntegerVector precedents(graph.precedents().begin(),
+                                 graph.precedents().end());
+  precedents = precedents + 1;
+
+  return Rcpp::List::create(
+      Rcpp::_["vertices"] = vertices,
+      Rcpp::_["offsets"] = graph.offsets(),
+      Rcpp::_["precedents"] = precedents
+      );
+}
+
+// [[Rcpp::export]]
+Rcpp::List xl_levels_(Rcpp::IntegerVector offsets,
+                      Rcpp::IntegerVector precedents,
+                      int threads)
+{
+  // Offsets are where each vertex's precedents begin, from 0, and end with
+  // how many there are
+  const int n_offsets = offsets.size();
+  if (n_offsets < 1 || offsets[0] != 0
+      || offsets[n_offsets - 1] != static_cast<int>(precedents.size())) {
+    Rcpp::stop("The offsets must begin at 0 and end at the number of precedents");
+  }
+  for (int v = 1; v < n_offsets; ++v) {
+    if (offsets[v] == NA_INTEGER || offsets[v] < offsets[v - 1]) {
+      Rcpp::stop("The offsets must not decrease");
+    }
+  }
+
+  // Vertices count from 1 in R
+  std::vector<int> from(offsets.begin(), offsets.end());
+  std::vector<int> to(precedents.begin(), precedents.end());
+  for (std::size_t e = 0; e < to.size(); ++e) {
+    if (to[e] == NA_INTEGER || to[e] < 1 || to[e] > n_offsets - 1) {
+      Rcpp::stop("The precedents must be vertices");
+    }
+    --to[e];
+  }
+
+  std::vector<int> levels;
+  xltoken::schedule_levels(from, to, as_threads(threads), levels);
+
+  // Only the vertices that never became free can be in cycles
+  int n = levels.size();
+  std::vector<bool> blocked(n);
+  for (int v = 0; v < n; ++v) {
+    blocked[v] = levels[v] == -1;
+  }
+  std::vector<int> cycles;
+  xltoken::find_cycles(from, to, blocked, cycles);
+
+  Rcpp::IntegerVector level(n), cycle(n);
+  for (int v = 0; v < n; ++v) {
+    level[v] = levels[v] == -1 ? NA_INTEGER : levels[v] + 1;
+    cycle[v] = cycles[v] == 0 ? NA_INTEGER : cycles[v];
+  }
+
+  Rcpp::List out = Rcpp::List::create(
+      Rcpp::_["level"] = level,
+      Rcpp::_["cycle"] = cycle
+      );
+  as_tibble(out, n);
+
+  return out;
+}
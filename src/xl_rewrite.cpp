@@ -0,0 +1,234 @@
+#include <Rcpp.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "structure.hpp"
+#include "rename.hpp"
+#include "shared.hpp"
+#include "wrap.hpp"
+
+// The rewritten formulas, reusing R's strings for those that didn't change.
+// The workers only see spans of R's strings, and R is only called again once
+// they've finished.
+static Rcpp::CharacterVector wrap_rewritten(Rcpp::CharacterVector x,
+                                            const std::vector<std::string> & rewritten,
+                                            const std::vector<bool> & changed)
+{
+  int n = x.size();
+  Rcpp::CharacterVector out(n);
+  for (int i = 0; i < n; ++i) {
+    if (changed[i]) {
+      out[i] = Rf_mkCharLenCE(rewritten[i].data(), rewritten[i].size(), CE_UTF8);
+    } else {
+      out[i] = STRING_ELT(x, i);
+    }
+  }
+  return out;
+}
+
+// The one string of an argument that must be a single string, not NA
+static xltoken::span as_string(Rcpp::CharacterVector x, const char * what)
+{
+  if (x.size() != 1 || STRING_ELT(x, 0) == NA_STRING) {
+    Rcpp::stop("%s must be a single string, not NA", what);
+  }
+  return as_spans(x)[0];
+}
+
+// [[Rcpp::export]]
+Rcpp::CharacterVector xl_shift_(Rcpp::CharacterVector x,
+                                Rcpp::CharacterVector sheet,
+                                Rcpp::CharacterVector edit_sheet,
+                                bool rows,
+                                int index,
+                                int count,
+                                int threads)
+{
+  // Bounded by the sheet, so that index - count can't overflow
+  const int max = rows ? xltoken::max_rows : xltoken::max_cols;
+  if (index == NA_INTEGER || index < 1 || index > max) {
+    Rcpp::stop("The index must be from 1 to %d", max);
+  }
+  if (count == NA_INTEGER || count == 0 || count < -max || count > max) {
+    Rcpp::stop("The count must be nonzero and from -%d to %d", max, max);
+  }
+
+  xltoken::structural_edit edit;
+  edit.sheet = as_string(edit_sheet, "The edited sheet");
+  edit.rows = rows;
+  edit.index = index;
+  edit.count = count;
+
+  std::vector<xltoken::span> sheets = as_spans(sheet);
+  std::vector<std::string> rewritten;
+  std::vector<bool> changed;
+  xltoken::rewrite_formulas(as_spans(x), xltoken::reference_shifter(sheets, edit),
+                            as_threads(threads), rewritten, changed);
+  return wrap_rewritten(x, rewritten, changed);
+}
+
+// [[Rcpp::export]]
+Rcpp::CharacterVector xl_rename_(Rcpp::CharacterVector x,
+                                 Rcpp::CharacterVector from,
+                                 Rcpp::CharacterVector to,
+                                 int threads)
+{
+  xltoken::span old_name = as_string(from, "The old sheet name");
+  xltoken::span new_name = as_string(to, "The new sheet name");
+  if (new_name.size == 0
+      || std::string(new_name.data, new_name.size).find_first_of("[]\\/*?:")
+         != std::string::npos) {
+    Rcpp::stop("Sheet names can't be empty or contain any of []\\/*?:");
+  }
+  // Excel counts characters, which in UTF-8 are the bytes that don't
+  // continue one
+  int characters = 0;
+  for (std::size_t i = 0; i < new_name.size; ++i) {
+    characters += (static_cast<unsigned char>(new_name.data[i]) & 0xC0) != 0x80;
+  }
+  if (characters > 31) {
+    Rcpp::stop("Sheet names can't be longer than 31 characters");
+  }
+  if (new_name.data[0] == '\'' || new_name.data[new_name.size - 1] == '\'') {
+    Rcpp::stop("Sheet names can't begin or end with '");
+  }
+
+  std::vector<std::string> rewritten;
+  std::vector<bool> changed;
+  xltoken::rewrite_formulas(as_spans(x),
+                            xltoken::sheet_renamer(old_name, new_name),
+                            as_threads(threads), rewritten, changed);
+  return wrap_rewritten(x, rewritten, changed);
+}
+
+// The R1C1 style of formulas x in cells (row, col), and their classes, which
+// are the same for formulas with the same R1C1 style, or 0 if they don't
+// parse or aren't in a cell
+static void r1c1_classes(Rcpp::IntegerVector row,
+                         Rcpp::IntegerVector col,
+                         Rcpp::CharacterVector x,
+                         int threads,
+                         std::vector<int> & rows,
+                         std::vector<int> & cols,
+                         std::vector<std::string> & r1c1,
+                         std::vector<int> & classes)
+{
+  if (row.size() != x.size() || col.size() != x.size()) {
+    Rcpp::stop("The rows, columns and formulas must be the same length");
+  }
+  rows.assign(row.begin(), row.end());
+  cols.assign(col.begin(), col.end());
+  std::vector<xltoken::span> formulas = as_spans(x);
+  int n = formulas.size();
+  for (int i = 0; i < n; ++i) {
+    if (rows[i] == NA_INTEGER || cols[i] == NA_INTEGER
+        || rows[i] < 1 || rows[i] > xltoken::max_rows
+        || cols[i] < 1 || cols[i] > xltoken::max_cols) {
+      formulas[i] = xltoken::span(); // not in a cell
+    }
+  }
+
+  std::vector<bool> parsed;
+  xltoken::rewrite_formulas(formulas, xltoken::r1c1_converter(rows, cols),
+                            as_threads(threads), r1c1, parsed);
+
+  std::unordered_map<std::string, int> class_of;
+  classes.assign(n, 0);
+  for (int i = 0; i < n; ++i) {
+    if (parsed[i]) {
+      classes[i] = class_of.insert(std::make_pair(r1c1[i], class_of.size() + 1))
+                     .first->second;
+    }
+  }
+}
+
+// [[Rcpp::export]]
+Rcpp::List xl_shared_(Rcpp::IntegerVector row,
+                      Rcpp::IntegerVector col,
+                      Rcpp::CharacterVector x,
+                      int threads)
+{
+  std::vector<int> rows, cols, classes;
+  std::vector<std::string> r1c1;
+  r1c1_classes(row, col, x, threads, rows, cols, r1c1, classes);
+  int n = classes.size();
+
+  std::vector<xltoken::shared_block> blocks;
+  std::vector<int> block_of;
+  xltoken::find_shared_blocks(rows, cols, classes, blocks, block_of);
+
+  int m = blocks.size();
+  Rcpp::IntegerVector master(m), first_row(m), first_col(m), last_row(m), last_col(m);
+  Rcpp::CharacterVector formula(m), master_r1c1(m);
+  for (int b = 0; b < m; ++b) {
+    const xltoken::shared_block & block = blocks[b];
+    master[b] = block.master + 1;
+    first_row[b] = block.first_row;
+    first_col[b] = block.first_col;
+    last_row[b] = block.last_row;
+    last_col[b] = block.last_col;
+    formula[b] = STRING_ELT(x, block.master);
+    const std::string & s = r1c1[block.master];
+    master_r1c1[b] = Rf_mkCharLenCE(s.data(), s.size(), CE_UTF8);
+  }
+  Rcpp::List out = Rcpp::List::create(
+      Rcpp::_["master"] = master,
+      Rcpp::_["first_row"] = first_row,
+      Rcpp::_["first_col"] = first_col,
+      Rcpp::_["last_row"] = last_row,
+      Rcpp::_["last_col"] = last_col,
+      Rcpp::_["formula"] = formula,
+      Rcpp::_["r1c1"] = master_r1c1
+      );
+  as_tibble(out, m);
+
+  Rcpp::IntegerVector block(n);
+  for (int i = 0; i < n; ++i) {
+    block[i] = block_of[i] == 0 ? NA_INTEGER : block_of[i];
+  }
+  return Rcpp::List::create(
+      Rcpp::_["blocks"] = out,
+      Rcpp::_["block"] = block
+      );
+}
+
+// [[Rcpp::export]]
+Rcpp::List xl_inconsistent_(Rcpp::IntegerVector row,
+                            Rcpp::IntegerVector col,
+                            Rcpp::CharacterVector x,
+                            int threads)
+{
+  std::vector<int> rows, cols, classes;
+  std::vector<std::string> r1c1;
+  r1c1_classes(row, col, x, threads, rows, cols, r1c1, classes);
+
+  std::vector<xltoken::inconsistency> found;
+  xltoken::find_inconsistent(rows, cols, classes, found);
+
+  int m = found.size();
+  Rcpp::IntegerVector formula(m), out_row(m), out_col(m), neighbour(m);
+  Rcpp::CharacterVector direction(m), r1c1_formula(m), r1c1_neighbour(m);
+  for (int i = 0; i < m; ++i) {
+    const xltoken::inconsistency & a = found[i];
+    formula[i] = a.formula + 1;
+    out_row[i] = rows[a.formula];
+    out_col[i] = cols[a.formula];
+    direction[i] = a.rows ? "row" : "column";
+    neighbour[i] = a.neighbour + 1;
+    const std::string & s = r1c1[a.formula];
+    const std::string & t = r1c1[a.neighbour];
+    r1c1_formula[i] = Rf_mkCharLenCE(s.data(), s.size(), CE_UTF8);
+    r1c1_neighbour[i] = Rf_mkCharLenCE(t.data(), t.size(), CE_UTF8);
+  }
+  Rcpp::List out = Rcpp::List::create(
+      Rcpp::_["formula"] = formula,
+      Rcpp::_["row"] = out_row,
+      Rcpp::_["col"] = out_col,
+      Rcpp::_["direction"] = direction,
+      Rcpp::_["neighbour"] = neighbour,
+      Rcpp::_["r1c1"] = r1c1_formula,
+      Rcpp::_["neighbour_r1c1"] = r1c1_neighbour
+      );
+  as_tibble(out, m);
+  return out;
+}
@@ -1,6 +1,15 @@
+#ifndef XLTOKEN_XLTOKEN_HPP
+#define XLTOKEN_XLTOKEN_HPP
+
 #include "tao/pegtl.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <string>
-#include <Rcpp.h>
+#include "fast_path.hpp"
+#include "lexer.hpp"
+#include "number.hpp"
+#include "token_table.hpp"
 
 using namespace tao::pegtl;
 
@@ -168,351 +177,351 @@ namespace xltoken
   // Excel functions declared in reverse-alphabetical order to make it search
   // for longer strings before matching shorter, similar ones.
   struct ExcelFunction1
-    : sor< string< 'Z', 'T', 'E', 'S', 'T' >,
-           string< 'Y', 'I', 'E', 'L', 'D', 'M', 'A', 'T' >,
-           string< 'Y', 'I', 'E', 'L', 'D', 'D', 'I', 'S', 'C' >,
-           string< 'Y', 'I', 'E', 'L', 'D' >,
-           string< 'Y', 'E', 'A', 'R', 'F', 'R', 'A', 'C' >,
-           string< 'Y', 'E', 'A', 'R' >,
-           string< 'X', 'N', 'P', 'V' >,
-           string< 'X', 'I', 'R', 'R' >,
-           string< 'W', 'O', 'R', 'K', 'D', 'A', 'Y' >,
-           string< 'W', 'E', 'I', 'B', 'U', 'L', 'L' >,
-           string< 'W', 'E', 'E', 'K', 'N', 'U', 'M' >,
-           string< 'W', 'E', 'E', 'K', 'D', 'A', 'Y' >,
-           string< 'V', 'L', 'O', 'O', 'K', 'U', 'P' >,
-           string< 'V', 'D', 'B' >,
-           string< 'V', 'A', 'R', 'P', 'A' >,
-           string< 'V', 'A', 'R', 'P' >,
-           string< 'V', 'A', 'R', 'A' >,
-           string< 'V', 'A', 'R' >,
-           string< 'V', 'A', 'L', 'U', 'E' >,
-           string< 'U', 'P', 'P', 'E', 'R' >,
-           string< 'T', 'Y', 'P', 'E' >,
-           string< 'T', 'T', 'E', 'S', 'T' >,
-           string< 'T', 'R', 'U', 'N', 'C' >,
-           string< 'T', 'R', 'U', 'E' >,
-           string< 'T', 'R', 'I', 'M', 'M', 'E', 'A', 'N' >,
-           string< 'T', 'R', 'I', 'M' >,
-           string< 'T', 'R', 'E', 'N', 'D' >,
-           string< 'T', 'R', 'A', 'N', 'S', 'P', 'O', 'S', 'E' >,
-           string< 'T', 'O', 'D', 'A', 'Y' >,
-           string< 'T', 'I', 'N', 'V' >,
-           string< 'T', 'I', 'M', 'E', 'V', 'A', 'L', 'U', 'E' >,
-           string< 'T', 'I', 'M', 'E' >,
-           string< 'T', 'E', 'X', 'T' >,
-           string< 'T', 'D', 'I', 'S', 'T' >,
-           string< 'T', 'B', 'I', 'L', 'L', 'Y', 'I', 'E', 'L', 'D' >,
-           string< 'T', 'B', 'I', 'L', 'L', 'P', 'R', 'I', 'C', 'E' >,
-           string< 'T', 'B', 'I', 'L', 'L', 'E', 'Q' >,
-           string< 'T', 'A', 'N', 'H' >,
-           string< 'T', 'A', 'N' >,
-           string< 'T' >,
-           string< 'S', 'Y', 'D' >,
-           string< 'S', 'U', 'M', 'X', 'M', 'Y', '2' >,
-           string< 'S', 'U', 'M', 'X', '2', 'P', 'Y', '2' >,
-           string< 'S', 'U', 'M', 'X', '2', 'M', 'Y', '2' >,
-           string< 'S', 'U', 'M', 'S', 'Q' >,
-           string< 'S', 'U', 'M', 'P', 'R', 'O', 'D', 'U', 'C', 'T' >,
-           string< 'S', 'U', 'M', 'I', 'F', 'S' >,
-           string< 'S', 'U', 'M', 'I', 'F' >,
-           string< 'S', 'U', 'M' >,
-           string< 'S', 'U', 'B', 'T', 'O', 'T', 'A', 'L' >,
-           string< 'S', 'U', 'B', 'S', 'T', 'I', 'T', 'U', 'T', 'E' >,
-           string< 'S', 'T', 'E', 'Y', 'X' >,
-           string< 'S', 'T', 'D', 'E', 'V', 'P', 'A' >,
-           string< 'S', 'T', 'D', 'E', 'V', 'P' >,
-           string< 'S', 'T', 'D', 'E', 'V', 'A' >,
-           string< 'S', 'T', 'D', 'E', 'V' >,
-           string< 'S', 'T', 'A', 'N', 'D', 'A', 'R', 'D', 'I', 'Z', 'E' >,
-           string< 'S', 'Q', 'R', 'T', 'P', 'I' >,
-           string< 'S', 'Q', 'R', 'T' >,
-           string< 'S', 'Q', 'L', '.', 'R', 'E', 'Q', 'U', 'E', 'S', 'T' >,
-           string< 'S', 'M', 'A', 'L', 'L' >,
-           string< 'S', 'L', 'O', 'P', 'E' >,
-           string< 'S', 'L', 'N' >,
-           string< 'S', 'K', 'E', 'W' >,
-           string< 'S', 'I', 'N', 'H' >,
-           string< 'S', 'I', 'N' >,
-           string< 'S', 'I', 'G', 'N' >,
-           string< 'S', 'E', 'R', 'I', 'E', 'S', 'S', 'U', 'M' >,
-           string< 'S', 'E', 'C', 'O', 'N', 'D' >,
-           string< 'S', 'E', 'A', 'R', 'C', 'H', 'B' >,
-           string< 'S', 'E', 'A', 'R', 'C', 'H' >,
-           string< 'R', 'T', 'D' >,
-           string< 'R', 'S', 'Q' >,
-           string< 'R', 'O', 'W', 'S' >,
-           string< 'R', 'O', 'W' >,
-           string< 'R', 'O', 'U', 'N', 'D', 'U', 'P' >,
-           string< 'R', 'O', 'U', 'N', 'D', 'D', 'O', 'W', 'N' >,
-           string< 'R', 'O', 'U', 'N', 'D' >,
-           string< 'R', 'O', 'M', 'A', 'N' >,
-           string< 'R', 'I', 'G', 'H', 'T', 'B' >,
-           string< 'R', 'I', 'G', 'H', 'T' >,
-           string< 'R', 'E', 'P', 'T' >,
-           string< 'R', 'E', 'P', 'L', 'A', 'C', 'E', 'B' >,
-           string< 'R', 'E', 'P', 'L', 'A', 'C', 'E' >,
-           string< 'R', 'E', 'G', 'I', 'S', 'T', 'E', 'R', '.', 'I', 'D' >,
-           string< 'R', 'E', 'C', 'E', 'I', 'V', 'E', 'D' >,
-           string< 'R', 'A', 'T', 'E' >,
-           string< 'R', 'A', 'N', 'K' >,
-           string< 'R', 'A', 'N', 'D', 'B', 'E', 'T', 'W', 'E', 'E', 'N' >,
-           string< 'R', 'A', 'N', 'D' >,
-           string< 'R', 'A', 'D', 'I', 'A', 'N', 'S' >,
-           string< 'Q', 'U', 'O', 'T', 'I', 'E', 'N', 'T' >,
-           string< 'Q', 'U', 'A', 'R', 'T', 'I', 'L', 'E' >,
-           string< 'P', 'V' >,
-           string< 'P', 'R', 'O', 'P', 'E', 'R' >,
-           string< 'P', 'R', 'O', 'D', 'U', 'C', 'T' >,
-           string< 'P', 'R', 'O', 'B' >,
-           string< 'P', 'R', 'I', 'C', 'E', 'M', 'A', 'T' >,
-           string< 'P', 'R', 'I', 'C', 'E', 'D', 'I', 'S', 'C' >,
-           string< 'P', 'R', 'I', 'C', 'E' >,
-           string< 'P', 'P', 'M', 'T' >,
-           string< 'P', 'O', 'W', 'E', 'R' >,
-           string< 'P', 'O', 'I', 'S', 'S', 'O', 'N' >,
-           string< 'P', 'M', 'T' >,
-           string< 'P', 'I' >,
-           string< 'P', 'H', 'O', 'N', 'E', 'T', 'I', 'C' >,
-           string< 'P', 'E', 'R', 'M', 'U', 'T' >,
-           string< 'P', 'E', 'R', 'C', 'E', 'N', 'T', 'R', 'A', 'N', 'K' >,
-           string< 'P', 'E', 'R', 'C', 'E', 'N', 'T', 'I', 'L', 'E' >,
-           string< 'P', 'E', 'A', 'R', 'S', 'O', 'N' >,
-           string< 'O', 'R' >,
-           string< 'O', 'D', 'D', 'L', 'Y', 'I', 'E', 'L', 'D' >,
-           string< 'O', 'D', 'D', 'L', 'P', 'R', 'I', 'C', 'E' >,
-           string< 'O', 'D', 'D', 'F', 'Y', 'I', 'E', 'L', 'D' >,
-           string< 'O', 'D', 'D', 'F', 'P', 'R', 'I', 'C', 'E' >,
-           string< 'O', 'D', 'D' >,
-           string< 'O', 'C', 'T', '2', 'H', 'E', 'X' >,
-           string< 'O', 'C', 'T', '2', 'D', 'E', 'C' >,
-           string< 'O', 'C', 'T', '2', 'B', 'I', 'N' >,
-           string< 'N', 'P', 'V' >,
-           string< 'N', 'P', 'E', 'R' >,
-           string< 'N', 'O', 'W' >,
-           string< 'N', 'O', 'T' >,
-           string< 'N', 'O', 'R', 'M', 'S', 'I', 'N', 'V' >,
-           string< 'N', 'O', 'R', 'M', 'S', 'D', 'I', 'S', 'T' >,
-           string< 'N', 'O', 'R', 'M', 'I', 'N', 'V' >,
-           string< 'N', 'O', 'R', 'M', 'D', 'I', 'S', 'T' >,
-           string< 'N', 'O', 'M', 'I', 'N', 'A', 'L' >,
-           string< 'N', 'E', 'T', 'W', 'O', 'R', 'K', 'D', 'A', 'Y', 'S' >,
-           string< 'N', 'E', 'G', 'B', 'I', 'N', 'O', 'M', 'D', 'I', 'S', 'T' >,
-           string< 'N', 'A' >,
-           string< 'N' >,
-           string< 'M', 'U', 'L', 'T', 'I', 'N', 'O', 'M', 'I', 'A', 'L' >,
-           string< 'M', 'R', 'O', 'U', 'N', 'D' >,
-           string< 'M', 'O', 'N', 'T', 'H' >,
-           string< 'M', 'O', 'D', 'E' >,
-           string< 'M', 'O', 'D' >,
-           string< 'M', 'M', 'U', 'L', 'T' >,
-           string< 'M', 'I', 'R', 'R' >,
-           string< 'M', 'I', 'N', 'V', 'E', 'R', 'S', 'E' >,
-           string< 'M', 'I', 'N', 'U', 'T', 'E' >,
-           string< 'M', 'I', 'N', 'A' >,
-           string< 'M', 'I', 'N' >,
-           string< 'M', 'I', 'D', 'B' >,
-           string< 'M', 'I', 'D' >,
-           string< 'M', 'E', 'D', 'I', 'A', 'N' >,
-           string< 'M', 'D', 'U', 'R', 'A', 'T', 'I', 'O', 'N' >,
-           string< 'M', 'D', 'E', 'T', 'E', 'R', 'M' >,
-           string< 'M', 'A', 'X', 'A' >,
-           string< 'M', 'A', 'X' >,
-           string< 'M', 'A', 'T', 'C', 'H' >,
-           string< 'L', 'O', 'W', 'E', 'R' >,
-           string< 'L', 'O', 'O', 'K', 'U', 'P' >,
-           string< 'L', 'O', 'G', 'N', 'O', 'R', 'M', 'D', 'I', 'S', 'T' >,
-           string< 'L', 'O', 'G', 'I', 'N', 'V' >,
-           string< 'L', 'O', 'G', 'E', 'S', 'T' >,
-           string< 'L', 'O', 'G', '1', '0' >,
-           string< 'L', 'O', 'G' >,
-           string< 'L', 'N' >,
-           string< 'L', 'I', 'N', 'E', 'S', 'T' >,
-           string< 'L', 'E', 'N', 'B' >,
-           string< 'L', 'E', 'N' >,
-           string< 'L', 'E', 'F', 'T', 'B' >,
-           string< 'L', 'E', 'F', 'T' >,
-           string< 'L', 'C', 'M' >,
-           string< 'L', 'A', 'R', 'G', 'E' >,
-           string< 'K', 'U', 'R', 'T' >,
-           string< 'J', 'I', 'S' >,
-           string< 'I', 'S', 'P', 'M', 'T' >,
-           string< 'I', 'S', 'N', 'U', 'M', 'B', 'E', 'R' >,
-           string< 'I', 'S', 'N', 'A' > >
+    : keywords< string< 'Z', 'T', 'E', 'S', 'T' >,
+                string< 'Y', 'I', 'E', 'L', 'D', 'M', 'A', 'T' >,
+                string< 'Y', 'I', 'E', 'L', 'D', 'D', 'I', 'S', 'C' >,
+                string< 'Y', 'I', 'E', 'L', 'D' >,
+                string< 'Y', 'E', 'A', 'R', 'F', 'R', 'A', 'C' >,
+                string< 'Y', 'E', 'A', 'R' >,
+                string< 'X', 'N', 'P', 'V' >,
+                string< 'X', 'I', 'R', 'R' >,
+                string< 'W', 'O', 'R', 'K', 'D', 'A', 'Y' >,
+                string< 'W', 'E', 'I', 'B', 'U', 'L', 'L' >,
+                string< 'W', 'E', 'E', 'K', 'N', 'U', 'M' >,
+                string< 'W', 'E', 'E', 'K', 'D', 'A', 'Y' >,
+                string< 'V', 'L', 'O', 'O', 'K', 'U', 'P' >,
+                string< 'V', 'D', 'B' >,
+                string< 'V', 'A', 'R', 'P', 'A' >,
+                string< 'V', 'A', 'R', 'P' >,
+                string< 'V', 'A', 'R', 'A' >,
+                string< 'V', 'A', 'R' >,
+                string< 'V', 'A', 'L', 'U', 'E' >,
+                string< 'U', 'P', 'P', 'E', 'R' >,
+                string< 'T', 'Y', 'P', 'E' >,
+                string< 'T', 'T', 'E', 'S', 'T' >,
+                string< 'T', 'R', 'U', 'N', 'C' >,
+                string< 'T', 'R', 'U', 'E' >,
+                string< 'T', 'R', 'I', 'M', 'M', 'E', 'A', 'N' >,
+                string< 'T', 'R', 'I', 'M' >,
+                string< 'T', 'R', 'E', 'N', 'D' >,
+                string< 'T', 'R', 'A', 'N', 'S', 'P', 'O', 'S', 'E' >,
+                string< 'T', 'O', 'D', 'A', 'Y' >,
+                string< 'T', 'I', 'N', 'V' >,
+                string< 'T', 'I', 'M', 'E', 'V', 'A', 'L', 'U', 'E' >,
+                string< 'T', 'I', 'M', 'E' >,
+                string< 'T', 'E', 'X', 'T' >,
+                string< 'T', 'D', 'I', 'S', 'T' >,
+                string< 'T', 'B', 'I', 'L', 'L', 'Y', 'I', 'E', 'L', 'D' >,
+                string< 'T', 'B', 'I', 'L', 'L', 'P', 'R', 'I', 'C', 'E' >,
+                string< 'T', 'B', 'I', 'L', 'L', 'E', 'Q' >,
+                string< 'T', 'A', 'N', 'H' >,
+                string< 'T', 'A', 'N' >,
+                string< 'T' >,
+                string< 'S', 'Y', 'D' >,
+                string< 'S', 'U', 'M', 'X', 'M', 'Y', '2' >,
+                string< 'S', 'U', 'M', 'X', '2', 'P', 'Y', '2' >,
+                string< 'S', 'U', 'M', 'X', '2', 'M', 'Y', '2' >,
+                string< 'S', 'U', 'M', 'S', 'Q' >,
+                string< 'S', 'U', 'M', 'P', 'R', 'O', 'D', 'U', 'C', 'T' >,
+                string< 'S', 'U', 'M', 'I', 'F', 'S' >,
+                string< 'S', 'U', 'M', 'I', 'F' >,
+                string< 'S', 'U', 'M' >,
+                string< 'S', 'U', 'B', 'T', 'O', 'T', 'A', 'L' >,
+                string< 'S', 'U', 'B', 'S', 'T', 'I', 'T', 'U', 'T', 'E' >,
+                string< 'S', 'T', 'E', 'Y', 'X' >,
+                string< 'S', 'T', 'D', 'E', 'V', 'P', 'A' >,
+                string< 'S', 'T', 'D', 'E', 'V', 'P' >,
+                string< 'S', 'T', 'D', 'E', 'V', 'A' >,
+                string< 'S', 'T', 'D', 'E', 'V' >,
+                string< 'S', 'T', 'A', 'N', 'D', 'A', 'R', 'D', 'I', 'Z', 'E' >,
+                string< 'S', 'Q', 'R', 'T', 'P', 'I' >,
+                string< 'S', 'Q', 'R', 'T' >,
+                string< 'S', 'Q', 'L', '.', 'R', 'E', 'Q', 'U', 'E', 'S', 'T' >,
+                string< 'S', 'M', 'A', 'L', 'L' >,
+                string< 'S', 'L', 'O', 'P', 'E' >,
+                string< 'S', 'L', 'N' >,
+                string< 'S', 'K', 'E', 'W' >,
+                string< 'S', 'I', 'N', 'H' >,
+                string< 'S', 'I', 'N' >,
+                string< 'S', 'I', 'G', 'N' >,
+                string< 'S', 'E', 'R', 'I', 'E', 'S', 'S', 'U', 'M' >,
+                string< 'S', 'E', 'C', 'O', 'N', 'D' >,
+                string< 'S', 'E', 'A', 'R', 'C', 'H', 'B' >,
+                string< 'S', 'E', 'A', 'R', 'C', 'H' >,
+                string< 'R', 'T', 'D' >,
+                string< 'R', 'S', 'Q' >,
+                string< 'R', 'O', 'W', 'S' >,
+                string< 'R', 'O', 'W' >,
+                string< 'R', 'O', 'U', 'N', 'D', 'U', 'P' >,
+                string< 'R', 'O', 'U', 'N', 'D', 'D', 'O', 'W', 'N' >,
+                string< 'R', 'O', 'U', 'N', 'D' >,
+                string< 'R', 'O', 'M', 'A', 'N' >,
+                string< 'R', 'I', 'G', 'H', 'T', 'B' >,
+                string< 'R', 'I', 'G', 'H', 'T' >,
+                string< 'R', 'E', 'P', 'T' >,
+                string< 'R', 'E', 'P', 'L', 'A', 'C', 'E', 'B' >,
+                string< 'R', 'E', 'P', 'L', 'A', 'C', 'E' >,
+                string< 'R', 'E', 'G', 'I', 'S', 'T', 'E', 'R', '.', 'I', 'D' >,
+                string< 'R', 'E', 'C', 'E', 'I', 'V', 'E', 'D' >,
+                string< 'R', 'A', 'T', 'E' >,
+                string< 'R', 'A', 'N', 'K' >,
+                string< 'R', 'A', 'N', 'D', 'B', 'E', 'T', 'W', 'E', 'E', 'N' >,
+                string< 'R', 'A', 'N', 'D' >,
+                string< 'R', 'A', 'D', 'I', 'A', 'N', 'S' >,
+                string< 'Q', 'U', 'O', 'T', 'I', 'E', 'N', 'T' >,
+                string< 'Q', 'U', 'A', 'R', 'T', 'I', 'L', 'E' >,
+                string< 'P', 'V' >,
+                string< 'P', 'R', 'O', 'P', 'E', 'R' >,
+                string< 'P', 'R', 'O', 'D', 'U', 'C', 'T' >,
+                string< 'P', 'R', 'O', 'B' >,
+                string< 'P', 'R', 'I', 'C', 'E', 'M', 'A', 'T' >,
+                string< 'P', 'R', 'I', 'C', 'E', 'D', 'I', 'S', 'C' >,
+                string< 'P', 'R', 'I', 'C', 'E' >,
+                string< 'P', 'P', 'M', 'T' >,
+                string< 'P', 'O', 'W', 'E', 'R' >,
+                string< 'P', 'O', 'I', 'S', 'S', 'O', 'N' >,
+                string< 'P', 'M', 'T' >,
+                string< 'P', 'I' >,
+                string< 'P', 'H', 'O', 'N', 'E', 'T', 'I', 'C' >,
+                string< 'P', 'E', 'R', 'M', 'U', 'T' >,
+                string< 'P', 'E', 'R', 'C', 'E', 'N', 'T', 'R', 'A', 'N', 'K' >,
+                string< 'P', 'E', 'R', 'C', 'E', 'N', 'T', 'I', 'L', 'E' >,
+                string< 'P', 'E', 'A', 'R', 'S', 'O', 'N' >,
+                string< 'O', 'R' >,
+                string< 'O', 'D', 'D', 'L', 'Y', 'I', 'E', 'L', 'D' >,
+                string< 'O', 'D', 'D', 'L', 'P', 'R', 'I', 'C', 'E' >,
+                string< 'O', 'D', 'D', 'F', 'Y', 'I', 'E', 'L', 'D' >,
+                string< 'O', 'D', 'D', 'F', 'P', 'R', 'I', 'C', 'E' >,
+                string< 'O', 'D', 'D' >,
+                string< 'O', 'C', 'T', '2', 'H', 'E', 'X' >,
+                string< 'O', 'C', 'T', '2', 'D', 'E', 'C' >,
+                string< 'O', 'C', 'T', '2', 'B', 'I', 'N' >,
+                string< 'N', 'P', 'V' >,
+                string< 'N', 'P', 'E', 'R' >,
+                string< 'N', 'O', 'W' >,
+                string< 'N', 'O', 'T' >,
+                string< 'N', 'O', 'R', 'M', 'S', 'I', 'N', 'V' >,
+                string< 'N', 'O', 'R', 'M', 'S', 'D', 'I', 'S', 'T' >,
+                string< 'N', 'O', 'R', 'M', 'I', 'N', 'V' >,
+                string< 'N', 'O', 'R', 'M', 'D', 'I', 'S', 'T' >,
+                string< 'N', 'O', 'M', 'I', 'N', 'A', 'L' >,
+                string< 'N', 'E', 'T', 'W', 'O', 'R', 'K', 'D', 'A', 'Y', 'S' >,
+                string< 'N', 'E', 'G', 'B', 'I', 'N', 'O', 'M', 'D', 'I', 'S', 'T' >,
+                string< 'N', 'A' >,
+                string< 'N' >,
+                string< 'M', 'U', 'L', 'T', 'I', 'N', 'O', 'M', 'I', 'A', 'L' >,
+                string< 'M', 'R', 'O', 'U', 'N', 'D' >,
+                string< 'M', 'O', 'N', 'T', 'H' >,
+                string< 'M', 'O', 'D', 'E' >,
+                string< 'M', 'O', 'D' >,
+                string< 'M', 'M', 'U', 'L', 'T' >,
+                string< 'M', 'I', 'R', 'R' >,
+                string< 'M', 'I', 'N', 'V', 'E', 'R', 'S', 'E' >,
+                string< 'M', 'I', 'N', 'U', 'T', 'E' >,
+                string< 'M', 'I', 'N', 'A' >,
+                string< 'M', 'I', 'N' >,
+                string< 'M', 'I', 'D', 'B' >,
+                string< 'M', 'I', 'D' >,
+                string< 'M', 'E', 'D', 'I', 'A', 'N' >,
+                string< 'M', 'D', 'U', 'R', 'A', 'T', 'I', 'O', 'N' >,
+                string< 'M', 'D', 'E', 'T', 'E', 'R', 'M' >,
+                string< 'M', 'A', 'X', 'A' >,
+                string< 'M', 'A', 'X' >,
+                string< 'M', 'A', 'T', 'C', 'H' >,
+                string< 'L', 'O', 'W', 'E', 'R' >,
+                string< 'L', 'O', 'O', 'K', 'U', 'P' >,
+                string< 'L', 'O', 'G', 'N', 'O', 'R', 'M', 'D', 'I', 'S', 'T' >,
+                string< 'L', 'O', 'G', 'I', 'N', 'V' >,
+                string< 'L', 'O', 'G', 'E', 'S', 'T' >,
+                string< 'L', 'O', 'G', '1', '0' >,
+                string< 'L', 'O', 'G' >,
+                string< 'L', 'N' >,
+                string< 'L', 'I', 'N', 'E', 'S', 'T' >,
+                string< 'L', 'E', 'N', 'B' >,
+                string< 'L', 'E', 'N' >,
+                string< 'L', 'E', 'F', 'T', 'B' >,
+                string< 'L', 'E', 'F', 'T' >,
+                string< 'L', 'C', 'M' >,
+                string< 'L', 'A', 'R', 'G', 'E' >,
+                string< 'K', 'U', 'R', 'T' >,
+                string< 'J', 'I', 'S' >,
+                string< 'I', 'S', 'P', 'M', 'T' >,
+                string< 'I', 'S', 'N', 'U', 'M', 'B', 'E', 'R' >,
+                string< 'I', 'S', 'N', 'A' > >
   {};
 
   struct ExcelFunction2
-    : sor< string< 'I', 'S', 'E', 'R', 'R', 'O', 'R' >,
-           string< 'I', 'S', 'B', 'L', 'A', 'N', 'K' >,
-           string< 'I', 'S', 'B' >,
-           string< 'I', 'S' >,
-           string< 'I', 'R', 'R' >,
-           string< 'I', 'P', 'M', 'T' >,
-           string< 'I', 'N', 'T', 'R', 'A', 'T', 'E' >,
-           string< 'I', 'N', 'T', 'E', 'R', 'C', 'E', 'P', 'T' >,
-           string< 'I', 'N', 'T' >,
-           string< 'I', 'N', 'F', 'O' >,
-           string< 'I', 'M', 'S', 'U', 'M' >,
-           string< 'I', 'M', 'S', 'U', 'B' >,
-           string< 'I', 'M', 'S', 'Q', 'R', 'T' >,
-           string< 'I', 'M', 'S', 'I', 'N' >,
-           string< 'I', 'M', 'R', 'E', 'A', 'L' >,
-           string< 'I', 'M', 'P', 'R', 'O', 'D', 'U', 'C', 'T' >,
-           string< 'I', 'M', 'P', 'O', 'W', 'E', 'R' >,
-           string< 'I', 'M', 'L', 'O', 'G', '2' >,
-           string< 'I', 'M', 'L', 'O', 'G', '1', '0' >,
-           string< 'I', 'M', 'L', 'N' >,
-           string< 'I', 'M', 'E', 'X', 'P' >,
-           string< 'I', 'M', 'D', 'I', 'V' >,
-           string< 'I', 'M', 'C', 'O', 'S' >,
-           string< 'I', 'M', 'C', 'O', 'N', 'J', 'U', 'G', 'A', 'T', 'E' >,
-           string< 'I', 'M', 'A', 'R', 'G', 'U', 'M', 'E', 'N', 'T' >,
-           string< 'I', 'M', 'A', 'G', 'I', 'N', 'A', 'R', 'Y' >,
-           string< 'I', 'M', 'A', 'B', 'S' >,
-           string< 'I', 'F', 'E', 'R', 'R', 'O', 'R' >,
-           string< 'H', 'Y', 'P', 'G', 'E', 'O', 'M', 'D', 'I', 'S', 'T' >,
-           string< 'H', 'Y', 'P', 'E', 'R', 'L', 'I', 'N', 'K' >,
-           string< 'H', 'O', 'U', 'R' >,
-           string< 'H', 'L', 'O', 'O', 'K', 'U', 'P' >,
-           string< 'H', 'E', 'X', '2', 'O', 'C', 'T' >,
-           string< 'H', 'E', 'X', '2', 'D', 'E', 'C' >,
-           string< 'H', 'E', 'X', '2', 'B', 'I', 'N' >,
-           string< 'H', 'A', 'R', 'M', 'E', 'A', 'N' >,
-           string< 'G', 'R', 'O', 'W', 'T', 'H' >,
-           string< 'G', 'E', 'T', 'P', 'I', 'V', 'O', 'T', 'D', 'A', 'T', 'A' >,
-           string< 'G', 'E', 'S', 'T', 'E', 'P' >,
-           string< 'G', 'E', 'O', 'M', 'E', 'A', 'N' >,
-           string< 'G', 'C', 'D' >,
-           string< 'G', 'A', 'M', 'M', 'A', 'L', 'N' >,
-           string< 'G', 'A', 'M', 'M', 'A', 'I', 'N', 'V' >,
-           string< 'G', 'A', 'M', 'M', 'A', 'D', 'I', 'S', 'T' >,
-           string< 'F', 'V', 'S', 'C', 'H', 'E', 'D', 'U', 'L', 'E' >,
-           string< 'F', 'V' >,
-           string< 'F', 'T', 'E', 'S', 'T' >,
-           string< 'F', 'R', 'E', 'Q', 'U', 'E', 'N', 'C', 'Y' >,
-           string< 'F', 'O', 'R', 'E', 'C', 'A', 'S', 'T' >,
-           string< 'F', 'L', 'O', 'O', 'R' >,
-           string< 'F', 'I', 'X', 'E', 'D' >,
-           string< 'F', 'I', 'S', 'H', 'E', 'R', 'I', 'N', 'V' >,
-           string< 'F', 'I', 'S', 'H', 'E', 'R' >,
-           string< 'F', 'I', 'N', 'V' >,
-           string< 'F', 'I', 'N', 'D' >,
-           string< 'F', 'D', 'I', 'S', 'T' >,
-           string< 'F', 'A', 'L', 'S', 'E' >,
-           string< 'F', 'A', 'C', 'T', 'D', 'O', 'U', 'B', 'L', 'E' >,
-           string< 'F', 'A', 'C', 'T' >,
-           string< 'E', 'X', 'P', 'O', 'N', 'D', 'I', 'S', 'T' >,
-           string< 'E', 'X', 'P' >,
-           string< 'E', 'X', 'A', 'C', 'T' >,
-           string< 'E', 'V', 'E', 'N' >,
-           string< 'E', 'U', 'R', 'O', 'C', 'O', 'N', 'V', 'E', 'R', 'T' >,
-           string< 'E', 'R', 'R', 'O', 'R', '.', 'T', 'Y', 'P', 'E' >,
-           string< 'E', 'R', 'F', 'C' >,
-           string< 'E', 'R', 'F' >,
-           string< 'E', 'O', 'M', 'O', 'N', 'T', 'H' >,
-           string< 'E', 'D', 'A', 'T', 'E', 'E', 'F', 'F', 'E', 'C', 'T' >,
-           string< 'D', 'V', 'A', 'R', 'P' >,
-           string< 'D', 'V', 'A', 'R' >,
-           string< 'D', 'U', 'R', 'A', 'T', 'I', 'O', 'N' >,
-           string< 'D', 'S', 'U', 'M' >,
-           string< 'D', 'S', 'T', 'D', 'E', 'V', 'P' >,
-           string< 'D', 'S', 'T', 'D', 'E', 'V' >,
-           string< 'D', 'P', 'R', 'O', 'D', 'U', 'C', 'T' >,
-           string< 'D', 'O', 'L', 'L', 'A', 'R', 'F', 'R' >,
-           string< 'D', 'O', 'L', 'L', 'A', 'R', 'D', 'E' >,
-           string< 'D', 'O', 'L', 'L', 'A', 'R' >,
-           string< 'D', 'M', 'I', 'N' >,
-           string< 'D', 'M', 'A', 'X' >,
-           string< 'D', 'I', 'S', 'C' >,
-           string< 'D', 'G', 'E', 'T' >,
-           string< 'D', 'E', 'V', 'S', 'Q' >,
-           string< 'D', 'E', 'L', 'T', 'A' >,
-           string< 'D', 'E', 'G', 'R', 'E', 'E', 'S' >,
-           string< 'D', 'E', 'C', '2', 'O', 'C', 'T' >,
-           string< 'D', 'E', 'C', '2', 'H', 'E', 'X' >,
-           string< 'D', 'E', 'C', '2', 'B', 'I', 'N' >,
-           string< 'D', 'D', 'B' >,
-           string< 'D', 'C', 'O', 'U', 'N', 'T', 'A' >,
-           string< 'D', 'C', 'O', 'U', 'N', 'T' >,
-           string< 'D', 'B' >,
-           string< 'D', 'A', 'Y', 'S', '3', '6', '0' >,
-           string< 'D', 'A', 'Y' >,
-           string< 'D', 'A', 'V', 'E', 'R', 'A', 'G', 'E' >,
-           string< 'D', 'A', 'T', 'E', 'V', 'A', 'L', 'U', 'E' >,
-           string< 'D', 'A', 'T', 'E' >,
-           string< 'C', 'U', 'M', 'P', 'R', 'I', 'N', 'C' >,
-           string< 'C', 'U', 'M', 'I', 'P', 'M', 'T' >,
-           string< 'C', 'U', 'B', 'E', 'V', 'A', 'L', 'U', 'E' >,
-           string< 'C', 'U', 'B', 'E', 'S', 'E', 'T', 'C', 'O', 'U', 'N', 'T' >,
-           string< 'C', 'U', 'B', 'E', 'S', 'E', 'T' >,
-           string< 'C', 'U', 'B', 'E', 'R', 'A', 'N', 'K', 'E', 'D', 'M', 'E', 'M', 'B', 'E', 'R' >,
-           string< 'C', 'U', 'B', 'E', 'M', 'E', 'M', 'B', 'E', 'R', 'P', 'R', 'O', 'P', 'E', 'R', 'T', 'Y' >,
-           string< 'C', 'U', 'B', 'E', 'M', 'E', 'M', 'B', 'E', 'R' >,
-           string< 'C', 'U', 'B', 'E', 'K', 'P', 'I', 'M', 'E', 'M', 'B', 'E', 'R' >,
-           string< 'C', 'R', 'I', 'T', 'B', 'I', 'N', 'O', 'M' >,
-           string< 'C', 'O', 'V', 'A', 'R' >,
-           string< 'C', 'O', 'U', 'P', 'P', 'C', 'D' >,
-           string< 'C', 'O', 'U', 'P', 'N', 'U', 'M' >,
-           string< 'C', 'O', 'U', 'P', 'N', 'C', 'D' >,
-           string< 'C', 'O', 'U', 'P', 'D', 'A', 'Y', 'S', 'N', 'C' >,
-           string< 'C', 'O', 'U', 'P', 'D', 'A', 'Y', 'S' >,
-           string< 'C', 'O', 'U', 'P', 'D', 'A', 'Y', 'B', 'S' >,
-           string< 'C', 'O', 'U', 'N', 'T', 'I', 'F', 'S' >,
-           string< 'C', 'O', 'U', 'N', 'T', 'I', 'F' >,
-           string< 'C', 'O', 'U', 'N', 'T', 'B', 'L', 'A', 'N', 'K' >,
-           string< 'C', 'O', 'U', 'N', 'T', 'A' >,
-           string< 'C', 'O', 'U', 'N', 'T' >,
-           string< 'C', 'O', 'S', 'H' >,
-           string< 'C', 'O', 'S' >,
-           string< 'C', 'O', 'R', 'R', 'E', 'L' >,
-           string< 'C', 'O', 'N', 'V', 'E', 'R', 'T' >,
-           string< 'C', 'O', 'N', 'F', 'I', 'D', 'E', 'N', 'C', 'E' >,
-           string< 'C', 'O', 'N', 'C', 'A', 'T', 'E', 'N', 'A', 'T', 'E' >,
-           string< 'C', 'O', 'M', 'P', 'L', 'E', 'X' >,
-           string< 'C', 'O', 'M', 'B', 'I', 'N' >,
-           string< 'C', 'O', 'L', 'U', 'M', 'N', 'S' >,
-           string< 'C', 'O', 'L', 'U', 'M', 'N' >,
-           string< 'C', 'O', 'D', 'E' >,
-           string< 'C', 'L', 'E', 'A', 'N' >,
-           string< 'C', 'H', 'I', 'T', 'E', 'S', 'T' >,
-           string< 'C', 'H', 'I', 'I', 'N', 'V' >,
-           string< 'C', 'H', 'I', 'D', 'I', 'S', 'T' >,
-           string< 'C', 'H', 'A', 'R' >,
-           string< 'C', 'E', 'L', 'L' >,
-           string< 'C', 'E', 'I', 'L', 'I', 'N', 'G' >,
-           string< 'C', 'A', 'L', 'L' >,
-           string< 'B', 'I', 'N', 'O', 'M', 'D', 'I', 'S', 'T' >,
-           string< 'B', 'I', 'N', '2', 'O', 'C', 'T' >,
-           string< 'B', 'I', 'N', '2', 'H', 'E', 'X' >,
-           string< 'B', 'I', 'N', '2', 'D', 'E', 'C' >,
-           string< 'B', 'E', 'T', 'A', 'I', 'N', 'V' >,
-           string< 'B', 'E', 'T', 'A', 'D', 'I', 'S', 'T' >,
-           string< 'B', 'E', 'S', 'S', 'E', 'L', 'Y' >,
-           string< 'B', 'E', 'S', 'S', 'E', 'L', 'K' >,
-           string< 'B', 'E', 'S', 'S', 'E', 'L', 'J' >,
-           string< 'B', 'E', 'S', 'S', 'E', 'L', 'I' >,
-           string< 'B', 'A', 'H', 'T', 'T', 'E', 'X', 'T' >,
-           string< 'A', 'V', 'E', 'R', 'A', 'G', 'E', 'I', 'F', 'S' >,
-           string< 'A', 'V', 'E', 'R', 'A', 'G', 'E', 'I', 'F' >,
-           string< 'A', 'V', 'E', 'R', 'A', 'G', 'E', 'A' >,
-           string< 'A', 'V', 'E', 'R', 'A', 'G', 'E' >,
-           string< 'A', 'V', 'E', 'D', 'E', 'V' >,
-           string< 'A', 'T', 'A', 'N', 'H' >,
-           string< 'A', 'T', 'A', 'N', '2' >,
-           string< 'A', 'T', 'A', 'N' >,
-           string< 'A', 'S', 'I', 'N', 'H' >,
-           string< 'A', 'S', 'I', 'N' >,
-           string< 'A', 'S', 'C' >,
-           string< 'A', 'R', 'E', 'A', 'S' >,
-           string< 'A', 'N', 'D' >,
-           string< 'A', 'M', 'O', 'R', 'L', 'I', 'N', 'C' >,
-           string< 'A', 'M', 'O', 'R', 'D', 'E', 'G', 'R', 'C' >,
-           string< 'A', 'D', 'D', 'R', 'E', 'S', 'S' >,
-           string< 'A', 'C', 'O', 'S', 'H' >,
-           string< 'A', 'C', 'O', 'S' >,
-           string< 'A', 'C', 'C', 'R', 'I', 'N', 'T', 'M' >,
-           string< 'A', 'C', 'C', 'R', 'I', 'N', 'T' >,
-           string< 'A', 'B', 'S' > >
+    : keywords< string< 'I', 'S', 'E', 'R', 'R', 'O', 'R' >,
+                string< 'I', 'S', 'B', 'L', 'A', 'N', 'K' >,
+                string< 'I', 'S', 'B' >,
+                string< 'I', 'S' >,
+                string< 'I', 'R', 'R' >,
+                string< 'I', 'P', 'M', 'T' >,
+                string< 'I', 'N', 'T', 'R', 'A', 'T', 'E' >,
+                string< 'I', 'N', 'T', 'E', 'R', 'C', 'E', 'P', 'T' >,
+                string< 'I', 'N', 'T' >,
+                string< 'I', 'N', 'F', 'O' >,
+                string< 'I', 'M', 'S', 'U', 'M' >,
+                string< 'I', 'M', 'S', 'U', 'B' >,
+                string< 'I', 'M', 'S', 'Q', 'R', 'T' >,
+                string< 'I', 'M', 'S', 'I', 'N' >,
+                string< 'I', 'M', 'R', 'E', 'A', 'L' >,
+                string< 'I', 'M', 'P', 'R', 'O', 'D', 'U', 'C', 'T' >,
+                string< 'I', 'M', 'P', 'O', 'W', 'E', 'R' >,
+                string< 'I', 'M', 'L', 'O', 'G', '2' >,
+                string< 'I', 'M', 'L', 'O', 'G', '1', '0' >,
+                string< 'I', 'M', 'L', 'N' >,
+                string< 'I', 'M', 'E', 'X', 'P' >,
+                string< 'I', 'M', 'D', 'I', 'V' >,
+                string< 'I', 'M', 'C', 'O', 'S' >,
+                string< 'I', 'M', 'C', 'O', 'N', 'J', 'U', 'G', 'A', 'T', 'E' >,
+                string< 'I', 'M', 'A', 'R', 'G', 'U', 'M', 'E', 'N', 'T' >,
+                string< 'I', 'M', 'A', 'G', 'I', 'N', 'A', 'R', 'Y' >,
+                string< 'I', 'M', 'A', 'B', 'S' >,
+                string< 'I', 'F', 'E', 'R', 'R', 'O', 'R' >,
+                string< 'H', 'Y', 'P', 'G', 'E', 'O', 'M', 'D', 'I', 'S', 'T' >,
+                string< 'H', 'Y', 'P', 'E', 'R', 'L', 'I', 'N', 'K' >,
+                string< 'H', 'O', 'U', 'R' >,
+                string< 'H', 'L', 'O', 'O', 'K', 'U', 'P' >,
+                string< 'H', 'E', 'X', '2', 'O', 'C', 'T' >,
+                string< 'H', 'E', 'X', '2', 'D', 'E', 'C' >,
+                string< 'H', 'E', 'X', '2', 'B', 'I', 'N' >,
+                string< 'H', 'A', 'R', 'M', 'E', 'A', 'N' >,
+                string< 'G', 'R', 'O', 'W', 'T', 'H' >,
+                string< 'G', 'E', 'T', 'P', 'I', 'V', 'O', 'T', 'D', 'A', 'T', 'A' >,
+                string< 'G', 'E', 'S', 'T', 'E', 'P' >,
+                string< 'G', 'E', 'O', 'M', 'E', 'A', 'N' >,
+                string< 'G', 'C', 'D' >,
+                string< 'G', 'A', 'M', 'M', 'A', 'L', 'N' >,
+                string< 'G', 'A', 'M', 'M', 'A', 'I', 'N', 'V' >,
+                string< 'G', 'A', 'M', 'M', 'A', 'D', 'I', 'S', 'T' >,
+                string< 'F', 'V', 'S', 'C', 'H', 'E', 'D', 'U', 'L', 'E' >,
+                string< 'F', 'V' >,
+                string< 'F', 'T', 'E', 'S', 'T' >,
+                string< 'F', 'R', 'E', 'Q', 'U', 'E', 'N', 'C', 'Y' >,
+                string< 'F', 'O', 'R', 'E', 'C', 'A', 'S', 'T' >,
+                string< 'F', 'L', 'O', 'O', 'R' >,
+                string< 'F', 'I', 'X', 'E', 'D' >,
+                string< 'F', 'I', 'S', 'H', 'E', 'R', 'I', 'N', 'V' >,
+                string< 'F', 'I', 'S', 'H', 'E', 'R' >,
+                string< 'F', 'I', 'N', 'V' >,
+                string< 'F', 'I', 'N', 'D' >,
+                string< 'F', 'D', 'I', 'S', 'T' >,
+                string< 'F', 'A', 'L', 'S', 'E' >,
+                string< 'F', 'A', 'C', 'T', 'D', 'O', 'U', 'B', 'L', 'E' >,
+                string< 'F', 'A', 'C', 'T' >,
+                string< 'E', 'X', 'P', 'O', 'N', 'D', 'I', 'S', 'T' >,
+                string< 'E', 'X', 'P' >,
+                string< 'E', 'X', 'A', 'C', 'T' >,
+                string< 'E', 'V', 'E', 'N' >,
+                string< 'E', 'U', 'R', 'O', 'C', 'O', 'N', 'V', 'E', 'R', 'T' >,
+                string< 'E', 'R', 'R', 'O', 'R', '.', 'T', 'Y', 'P', 'E' >,
+                string< 'E', 'R', 'F', 'C' >,
+                string< 'E', 'R', 'F' >,
+                string< 'E', 'O', 'M', 'O', 'N', 'T', 'H' >,
+                string< 'E', 'D', 'A', 'T', 'E', 'E', 'F', 'F', 'E', 'C', 'T' >,
+                string< 'D', 'V', 'A', 'R', 'P' >,
+                string< 'D', 'V', 'A', 'R' >,
+                string< 'D', 'U', 'R', 'A', 'T', 'I', 'O', 'N' >,
+                string< 'D', 'S', 'U', 'M' >,
+                string< 'D', 'S', 'T', 'D', 'E', 'V', 'P' >,
+                string< 'D', 'S', 'T', 'D', 'E', 'V' >,
+                string< 'D', 'P', 'R', 'O', 'D', 'U', 'C', 'T' >,
+                string< 'D', 'O', 'L', 'L', 'A', 'R', 'F', 'R' >,
+                string< 'D', 'O', 'L', 'L', 'A', 'R', 'D', 'E' >,
+                string< 'D', 'O', 'L', 'L', 'A', 'R' >,
+                string< 'D', 'M', 'I', 'N' >,
+                string< 'D', 'M', 'A', 'X' >,
+                string< 'D', 'I', 'S', 'C' >,
+                string< 'D', 'G', 'E', 'T' >,
+                string< 'D', 'E', 'V', 'S', 'Q' >,
+                string< 'D', 'E', 'L', 'T', 'A' >,
+                string< 'D', 'E', 'G', 'R', 'E', 'E', 'S' >,
+                string< 'D', 'E', 'C', '2', 'O', 'C', 'T' >,
+                string< 'D', 'E', 'C', '2', 'H', 'E', 'X' >,
+                string< 'D', 'E', 'C', '2', 'B', 'I', 'N' >,
+                string< 'D', 'D', 'B' >,
+                string< 'D', 'C', 'O', 'U', 'N', 'T', 'A' >,
+                string< 'D', 'C', 'O', 'U', 'N', 'T' >,
+                string< 'D', 'B' >,
+                string< 'D', 'A', 'Y', 'S', '3', '6', '0' >,
+                string< 'D', 'A', 'Y' >,
+                string< 'D', 'A', 'V', 'E', 'R', 'A', 'G', 'E' >,
+                string< 'D', 'A', 'T', 'E', 'V', 'A', 'L', 'U', 'E' >,
+                string< 'D', 'A', 'T', 'E' >,
+                string< 'C', 'U', 'M', 'P', 'R', 'I', 'N', 'C' >,
+                string< 'C', 'U', 'M', 'I', 'P', 'M', 'T' >,
+                string< 'C', 'U', 'B', 'E', 'V', 'A', 'L', 'U', 'E' >,
+                string< 'C', 'U', 'B', 'E', 'S', 'E', 'T', 'C', 'O', 'U', 'N', 'T' >,
+                string< 'C', 'U', 'B', 'E', 'S', 'E', 'T' >,
+                string< 'C', 'U', 'B', 'E', 'R', 'A', 'N', 'K', 'E', 'D', 'M', 'E', 'M', 'B', 'E', 'R' >,
+                string< 'C', 'U', 'B', 'E', 'M', 'E', 'M', 'B', 'E', 'R', 'P', 'R', 'O', 'P', 'E', 'R', 'T', 'Y' >,
+                string< 'C', 'U', 'B', 'E', 'M', 'E', 'M', 'B', 'E', 'R' >,
+                string< 'C', 'U', 'B', 'E', 'K', 'P', 'I', 'M', 'E', 'M', 'B', 'E', 'R' >,
+                string< 'C', 'R', 'I', 'T', 'B', 'I', 'N', 'O', 'M' >,
+                string< 'C', 'O', 'V', 'A', 'R' >,
+                string< 'C', 'O', 'U', 'P', 'P', 'C', 'D' >,
+                string< 'C', 'O', 'U', 'P', 'N', 'U', 'M' >,
+                string< 'C', 'O', 'U', 'P', 'N', 'C', 'D' >,
+                string< 'C', 'O', 'U', 'P', 'D', 'A', 'Y', 'S', 'N', 'C' >,
+                string< 'C', 'O', 'U', 'P', 'D', 'A', 'Y', 'S' >,
+                string< 'C', 'O', 'U', 'P', 'D', 'A', 'Y', 'B', 'S' >,
+                string< 'C', 'O', 'U', 'N', 'T', 'I', 'F', 'S' >,
+                string< 'C', 'O', 'U', 'N', 'T', 'I', 'F' >,
+                string< 'C', 'O', 'U', 'N', 'T', 'B', 'L', 'A', 'N', 'K' >,
+                string< 'C', 'O', 'U', 'N', 'T', 'A' >,
+                string< 'C', 'O', 'U', 'N', 'T' >,
+                string< 'C', 'O', 'S', 'H' >,
+                string< 'C', 'O', 'S' >,
+                string< 'C', 'O', 'R', 'R', 'E', 'L' >,
+                string< 'C', 'O', 'N', 'V', 'E', 'R', 'T' >,
+                string< 'C', 'O', 'N', 'F', 'I', 'D', 'E', 'N', 'C', 'E' >,
+                string< 'C', 'O', 'N', 'C', 'A', 'T', 'E', 'N', 'A', 'T', 'E' >,
+                string< 'C', 'O', 'M', 'P', 'L', 'E', 'X' >,
+                string< 'C', 'O', 'M', 'B', 'I', 'N' >,
+                string< 'C', 'O', 'L', 'U', 'M', 'N', 'S' >,
+                string< 'C', 'O', 'L', 'U', 'M', 'N' >,
+                string< 'C', 'O', 'D', 'E' >,
+                string< 'C', 'L', 'E', 'A', 'N' >,
+                string< 'C', 'H', 'I', 'T', 'E', 'S', 'T' >,
+                string< 'C', 'H', 'I', 'I', 'N', 'V' >,
+                string< 'C', 'H', 'I', 'D', 'I', 'S', 'T' >,
+                string< 'C', 'H', 'A', 'R' >,
+                string< 'C', 'E', 'L', 'L' >,
+                string< 'C', 'E', 'I', 'L', 'I', 'N', 'G' >,
+                string< 'C', 'A', 'L', 'L' >,
+                string< 'B', 'I', 'N', 'O', 'M', 'D', 'I', 'S', 'T' >,
+                string< 'B', 'I', 'N', '2', 'O', 'C', 'T' >,
+                string< 'B', 'I', 'N', '2', 'H', 'E', 'X' >,
+                string< 'B', 'I', 'N', '2', 'D', 'E', 'C' >,
+                string< 'B', 'E', 'T', 'A', 'I', 'N', 'V' >,
+                string< 'B', 'E', 'T', 'A', 'D', 'I', 'S', 'T' >,
+                string< 'B', 'E', 'S', 'S', 'E', 'L', 'Y' >,
+                string< 'B', 'E', 'S', 'S', 'E', 'L', 'K' >,
+                string< 'B', 'E', 'S', 'S', 'E', 'L', 'J' >,
+                string< 'B', 'E', 'S', 'S', 'E', 'L', 'I' >,
+                string< 'B', 'A', 'H', 'T', 'T', 'E', 'X', 'T' >,
+                string< 'A', 'V', 'E', 'R', 'A', 'G', 'E', 'I', 'F', 'S' >,
+                string< 'A', 'V', 'E', 'R', 'A', 'G', 'E', 'I', 'F' >,
+                string< 'A', 'V', 'E', 'R', 'A', 'G', 'E', 'A' >,
+                string< 'A', 'V', 'E', 'R', 'A', 'G', 'E' >,
+                string< 'A', 'V', 'E', 'D', 'E', 'V' >,
+                string< 'A', 'T', 'A', 'N', 'H' >,
+                string< 'A', 'T', 'A', 'N', '2' >,
+                string< 'A', 'T', 'A', 'N' >,
+                string< 'A', 'S', 'I', 'N', 'H' >,
+                string< 'A', 'S', 'I', 'N' >,
+                string< 'A', 'S', 'C' >,
+                string< 'A', 'R', 'E', 'A', 'S' >,
+                string< 'A', 'N', 'D' >,
+                string< 'A', 'M', 'O', 'R', 'L', 'I', 'N', 'C' >,
+                string< 'A', 'M', 'O', 'R', 'D', 'E', 'G', 'R', 'C' >,
+                string< 'A', 'D', 'D', 'R', 'E', 'S', 'S' >,
+                string< 'A', 'C', 'O', 'S', 'H' >,
+                string< 'A', 'C', 'O', 'S' >,
+                string< 'A', 'C', 'C', 'R', 'I', 'N', 'T', 'M' >,
+                string< 'A', 'C', 'C', 'R', 'I', 'N', 'T' >,
+                string< 'A', 'B', 'S' > >
   {};
 
   struct ExcelFunction
@@ -563,7 +572,7 @@ namespace xltoken
   // TextToken matches two QuoteD (") and anything between, i.e. character and
   // the surrounding pair of double-quotes.
   struct DoubleQuotedString : star< sor< seq< QuoteD, QuoteD >,
-                                         NotQuoteD > >
+                                         plus_not_one< '"' > > >
   {};
 
   struct TextToken : if_must< QuoteD, DoubleQuotedString, QuoteD > {};
@@ -596,8 +605,8 @@ namespace xltoken
     : seq< normalSheetName,
            sor< exclamation, // just one sheet
                 seq< colon, // range of sheets
-                     normalSheetName,
-                     exclamation > > >
+                    normalSheetName,
+                    exclamation > > >
   {};
 
   struct SheetsQuotedToken
@@ -611,20 +620,20 @@ namespace xltoken
   {};
 
   struct normalSheetName
-    : plus< not_one< '[', ']',
-                     '\\', '/',
-                     '(', ')',
-                     '{', '}',
-                     '<', '>',
-                     '+', '-',
-                     '\'', '*', ':', '?', '=', '^', '%',
-                     ';', '#', '"', '&', ',', ' ', '!'> >
+    : plus_not_one< '[', ']',
+                    '\\', '/',
+                    '(', ')',
+                    '{', '}',
+                    '<', '>',
+                    '+', '-',
+                    '\'', '*', ':', '?', '=', '^', '%',
+                    ';', '#', '"', '&', ',', ' ', '!'>
   {};
 
   struct quotedSheetName
-    : star< sor< not_one< '[', ']',
-                          '\\', '/',
-                          '\'', '*', ':', '?' >,
+    : star< sor< plus_not_one< '[', ']',
+                               '\\', '/',
+                               '\'', '*', ':', '?' >,
                  string< '\'', '\'' > > >
   {};
 
@@ -636,7 +645,7 @@ namespace xltoken
 
   // SingleQuotedStringToken is the single-quoted equivalent of TextToken
   struct SingleQuotedString : star< sor< seq< QuoteS, QuoteS >,
-                                         NotQuoteS > >
+                                         plus_not_one< '\'' > > >
   {};
   struct SingleQuotedStringToken
     : if_must< QuoteS, SingleQuotedString, QuoteS >
@@ -859,7 +868,9 @@ namespace xltoken
            CloseSquareParen >
   {};
 
-  struct StructuredReferenceTable : NameToken {};
+  // Only a table if followed by [, otherwise it's a NamedRange.  Looking
+  // ahead stops the tokenize action firing for every name.
+  struct StructuredReferenceTable : seq< NameToken, at< OpenSquareParen > > {};
 
   struct StructuredReferenceExpression
     : seq< StructuredReferenceElement,
@@ -912,313 +923,320 @@ namespace xltoken
   template<> struct tokenize< SRColumnToken >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("SR-COLUMN");
-        tokens.push_back(in.string());
+        out.push("SR-COLUMN", in);
       }
   };
 
   template<> struct tokenize< Text >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("STRING");
-        tokens.push_back(in.string());
+        // The value is what's between the quotes, with "" unescaped to "
+        out.push("STRING", in,
+                 unescape(in.begin() + 1, in.end() - 1, '"', out.strings));
       }
   };
 
   template<> struct tokenize< SheetsQuotedToken >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("SHEETS-QUOTED");
-        tokens.push_back(in.string());
+        // The opening quote is matched by Prefix, so the value is everything
+        // before the closing '!, with '' unescaped to '
+        span name = unescape(in.begin(), in.end() - 2, '\'', out.strings);
+        out.push_name("SHEETS-QUOTED", in, name, name);
+      }
+  };
+
+  template<> struct tokenize< StructuredReferenceTable >
+  {
+    template< typename Input >
+      static void apply( const Input & in, token_table & out )
+      {
+        out.push_name("SR-TABLE", in, span(in.begin(), in.size()));
       }
   };
 
   template<> struct tokenize< ReservedName >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("RESERVED-NAME");
-        tokens.push_back(in.string());
+        out.push("RESERVED-NAME", in);
       }
   };
 
   template<> struct tokenize< ExcelConditionalRefFunctionToken >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("REF-FUNCTION-COND");
-        tokens.push_back(in.string());
+        out.push("REF-FUNCTION-COND", in);
       }
   };
 
   template<> struct tokenize< ExcelRefFunctionToken >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("REF-FUNCTION");
-        tokens.push_back(in.string());
+        out.push("REF-FUNCTION", in);
       }
   };
 
   template<> struct tokenize< Number >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("NUMBER");
-        tokens.push_back(in.string());
+        out.push("NUMBER", in);
+        out.numbers.back() = parse_number(in.begin(), in.end());
       }
   };
 
   template<> struct tokenize< UDFunctionCall >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("UDF");
-        tokens.push_back(in.string());
+        // The name is everything before the (, including any _xll.
+        const char * paren = std::find(in.begin(), in.end(), '(');
+        out.push_name("UDF", in, span(in.begin(), paren - in.begin()));
       }
   };
 
   template<> struct tokenize< NamedRange >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("NAME");
-        tokens.push_back(in.string());
+        out.push_name("NAME", in, span(in.begin(), in.size()));
       }
   };
 
   template<> struct tokenize< SheetsToken >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("SHEETS");
-        tokens.push_back(in.string());
+        out.push_name("SHEETS", in, span(in.begin(), in.size() - 1)); // drop !
       }
   };
 
   template<> struct tokenize< VRange >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("VERTICAL-RANGE");
-        tokens.push_back(in.string());
+        out.push("VERTICAL-RANGE", in);
       }
   };
 
   template<> struct tokenize< HRange >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("HORIZONTAL-RANGE");
-        tokens.push_back(in.string());
+        out.push("HORIZONTAL-RANGE", in);
       }
   };
 
   template<> struct tokenize< FunctionName >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("EXCEL-FUNCTION");
-        tokens.push_back(in.string());
+        out.push("EXCEL-FUNCTION", in);
       }
   };
 
   template<> struct tokenize< RefError >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("ERROR-REF");
-        tokens.push_back(in.string());
+        out.push("ERROR-REF", in);
       }
   };
 
   template<> struct tokenize< Error >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("ERROR");
-        tokens.push_back(in.string());
+        out.push("ERROR", in);
       }
   };
 
   template<> struct tokenize< DynamicDataExchange >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("DDECALL");
-        tokens.push_back(in.string());
+        out.push("DDECALL", in);
       }
   };
 
   template<> struct tokenize< Cell >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("CELL");
-        tokens.push_back(in.string());
+        out.push("CELL", in);
       }
   };
 
   template<> struct tokenize< Bool >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("BOOL");
-        tokens.push_back(in.string());
+        out.push("BOOL", in);
       }
   };
 
   template<> struct tokenize< rangeop >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("RANGE-OP");
-        tokens.push_back(in.string());
+        out.push("RANGE-OP", in);
       }
   };
 
   template<> struct tokenize< intersectop >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("INTERSECT-OP");
-        tokens.push_back(in.string());
+        out.push("INTERSECT-OP", in);
       }
   };
 
   template<> struct tokenize< unionop >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("UNION-OP");
-        tokens.push_back(in.string());
+        out.push("UNION-OP", in);
       }
   };
 
   template<> struct tokenize< PrefixOp >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("PREFIX-OP");
-        tokens.push_back(in.string());
+        out.push("PREFIX-OP", in);
       }
   };
 
   template<> struct tokenize< InfixOp >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("INFIX-OP");
-        tokens.push_back(in.string());
+        out.push("INFIX-OP", in);
       }
   };
 
   template<> struct tokenize< PostfixOp >
   {
     template< typename Input >
-      static void apply( const Input & in,
-                         std::vector<std::string> & types,
-                         std::vector<std::string> & tokens)
+      static void apply( const Input & in, token_table & out )
       {
         /* Rcpp::Rcout << "Ref: " << in.string() << "\n"; */
-        types.push_back("POSTFIX-OP");
-        tokens.push_back(in.string());
+        out.push("POSTFIX-OP", in);
       }
   };
 
+  // How many rules a formula may start before it's abandoned, so that one
+  // that makes the grammar backtrack pathologically can't stall a batch, and
+  // how many have been.  Shared by every thread, and 0 is no limit.
+  struct parse_budget
+  {
+    std::atomic< std::size_t > steps;
+    std::atomic< std::uint64_t > exceeded;
+
+    parse_budget() : steps( 10000000 ), exceeded( 0 ) {}
+  };
+
+  inline parse_budget & formula_budget()
+  {
+    static parse_budget budget;
+    return budget;
+  }
+
+  struct budget_exceeded {};
+
+  // Counts the rules a formula starts against its budget
+  template< typename Rule >
+    struct budget_control : normal< Rule >
+    {
+      template< typename Input >
+        static void start( const Input &, token_table & out )
+        {
+          if ( out.budget != 0 && ++out.steps > out.budget ) {
+            throw budget_exceeded();
+          }
+        }
+    };
+
+  // Tokenize one formula, appending its tokens to a table.  Returns false if
+  // the formula couldn't be parsed.  A formula that runs out of budget is
+  // one BUDGET_EXCEEDED token instead.  Formulas of the commonest shapes
+  // don't need the grammar at all (see fast_path.hpp).
+  inline bool parse_formula( const char * data,
+                             const std::size_t size,
+                             token_table & out )
+  {
+    out.formula_begin = data;
+    out.steps = 0;
+    out.budget = formula_budget().steps.load( std::memory_order_relaxed );
+    const bool trivial = tokenize_trivial( data, size, out );
+    fast_path().count( trivial );
+    if ( trivial ) {
+      return true;
+    }
+    memory_input<> in_mem( data, size, "original-formula" );
+    const std::size_t first = out.size();
+    try {
+      return parse< root, tokenize, budget_control >( in_mem, out );
+    } catch ( const budget_exceeded & ) {
+      out.truncate( first );
+      out.push_status( "BUDGET_EXCEEDED", span( data, size ) );
+      ++formula_budget().exceeded;
+      return false;
+    }
+  }
+
 } // xltoken
+
+#endif